@@ -9,6 +9,9 @@
 #include <QApplication>
 #include <QBrush>
 #include <QByteArray>
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
 #include <QChar>
 #include <QCloseEvent>
 #include <QColor>
@@ -28,6 +31,10 @@
 #include <QFlags>
 #include <QFont>
 #include <QFontMetricsF>
+#include <QHash>
+#include <QAbstractListModel>
+#include <QListView>
+#include <QScrollBar>
 #include <QGraphicsEllipseItem>
 #include <QGraphicsLineItem>
 #include <QGraphicsSimpleTextItem>
@@ -45,6 +52,7 @@
 #include <QList>
 #include <QMainWindow>
 #include <QMessageBox>
+#include <QMutex>
 #include <QObject>
 #include <QPalette>
 #include <QPen>
@@ -63,6 +71,7 @@
 #include <QSettings>
 #include <QSerialPortInfo>
 #include <QSerialPort>
+#include <QSet>
 #include <QSpinBox>
 #include <QStandardItemModel>
 #include <QStandardPaths>
@@ -72,6 +81,7 @@
 #include <QStyledItemDelegate>
 #include <QTableView>
 #include <QTcpSocket>
+#include <QSocketNotifier>
 #include <QtGlobal>
 #include <QThread>
 #include <QTime>
@@ -90,7 +100,12 @@
 
 //#include <stdio.h>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <cmath>
+#include <climits>
+#include <atomic>
+#include <algorithm>
 //#include <iostream>
 
 // N4OGW:
@@ -127,26 +142,67 @@ const QColor txtClr = Qt::black; // highlighted text color to set
 const int coChannel[NRIG] = { 1, 0, 3, 2, 5, 4, 7, 6 };
 
 const QString websocketPort_def = QStringLiteral("7300");
-
-//sql queries
-// %2 additional matching, %3 sorting, %4 addditional statement (ie. join)
-const QString kSelectGroupSQL = "SELECT groups.id as id, groups.name as name, groups.label as label,"
-                            " groups.display_mode as display_mode from groups"
-                            " inner join band_group_map on band_group_map.group_id = groups.id"
-                            " inner join bands on bands.id = band_group_map.band_id %4"
-                            " where groups.enabled = 1 and bands.id = %1 %2 %3";
-
-// %2 additional matching, %3 sorting
-const QString kSelectAntennaSQL = "select antennas.id as id, antennas.name as name, antennas.label as label,"
-                              " antennas.start_deg as start_deg, antennas.stop_deg as stop_deg,"
-                              " antennas.scan as scan, antennas.priority as priority,"
-                              " antennas.switch_port as switch_port from antennas"
-                              " inner join group_antenna_map on group_antenna_map.antenna_id = antennas.id"
-                              " inner join groups on groups.id = group_antenna_map.group_id"
-                              " where antennas.enabled = 1 and groups.id = %1 %2 %3";
+// outbound limits per websocket client, settings only
+const int websocketHighWater_def = 65536;  // bytes handed to the socket and not yet written
+const int websocketMaxQueue_def = 262144;  // bytes held back, client disconnected above
+const int websocketStallTime_def = 10000;  // ms above high water before disconnecting
+// client compass drags, only the latest bearing is applied at most once per
+// interval (0: once per event loop turn), settings only
+const int bearingInterval_def = 50; // ms
 
 const QString kAuxData = "AUX 0 %1 %2\r";
 
+// binary (CBOR) websocket protocol, chosen by the client at registration
+// with {"radio": N, "protocol": "cbor"}. "object" and "method" are sent as
+// integer keys 0 and 1 holding the index in these lists, only append
+const QStringList kWsObjects = { "protocol", "frame", "ptt", "radioName",
+                                 "hpfLabel", "bpfLabel", "gainLabel", "auxLabel",
+                                 "cbBand", "cbGroup", "cbLinked", "cbScanDelay",
+                                 "pbScan", "pbScanEnabled", "pbLock", "pbTrack",
+                                 "bearingLabel", "StackedLayout", "AntennaButtons",
+                                 "GraphicsLabels", "GraphicsLines", "GraphicsEllipse" };
+const QStringList kWsMethods = { "ids", "setText", "setCurrentText", "setCurrentIndex",
+                                 "setEnabled", "addItem", "state", "status",
+                                 "update", "create", "delta" };
+const QString kWsProtocolCbor = QStringLiteral("cbor");
+
+// "update" of these objects is sent as a "delta" holding only the list
+// entries that changed ({"index": i, changed fields...}) to clients known
+// to hold the previous version, full otherwise. clients that miss a
+// version send {"action": "resync"}
+const int kNDeltaObjects = 3;
+const int kDeltaLabels = 0;
+const int kDeltaEllipse = 1;
+const int kDeltaButtons = 2;
+const QString kWsDeltaObjects[kNDeltaObjects] = { "GraphicsLabels", "GraphicsEllipse", "AntennaButtons" };
+const QString kWsDeltaLists[kNDeltaObjects] = { "labels", "ellipses", "buttons" };
+
+// logs, entries go through a fixed ring to the writer thread which keeps
+// rotating files in <config dir>/logs and feeds the log tab
+const int kLogSerial = 0;
+const int kLogJson = 1;
+const int kLogCron = 2;
+const int kLogServer = 3;
+const int kNLogs = 4;
+const QString kLogNames[kNLogs] = { "serial", "json", "cron", "server" };
+const int kLogRingSize = 8192;               // entries, power of 2
+const int kLogTailSize = 20000;              // entries kept for display per log
+const qint64 kLogFileSize = 10 * 1024 * 1024; // bytes before rotating
+const int kLogFiles = 5;                     // rotated files kept
+const bool logToFile_def = true;
+const bool journal_def = true;          // record antenna switching
+
+// RS485 output, commands are queued to the I/O thread and written one at a
+// time
+const int kRs485RingSize = 256;     // commands in flight to the I/O thread, power of 2
+const int kRs485WriteTimeout = 1000; // ms without progress before a command fails
+
+// rigctld replies, one newline terminated record per command
+const int kRigctldRxSize = 4096;    // receive ring buffer
+const int kRigctldLineSize = 256;   // longest record kept
+const int kRigctldMaxPending = 32;  // commands awaiting reply
+const int kRigctldStatsInterval = 60000; // ms between pipeline stats in the server log
+
 const QString s_radioBaudRate[NRIG]={"radios/radioBaudRate_1","radios/radioBaudRate_2",
                                      "radios/radioBaudRate_3","radios/radioBaudRate_4",
                                      "radios/radioBaudRate_5","radios/radioBaudRate_6",
@@ -236,4 +292,30 @@ const QString s_radioPollTime[NRIG]={"radios/radioPollTime_1","radios/radioPollT
                                      "radios/radioPollTime_3","radios/radioPollTime_4",
                                      "radios/radioPollTime_5","radios/radioPollTime_6",
                                      "radios/radioPollTime_7","radios/radioPollTime_8" };
-const int s_radioPollTime_def = 500;
+const int s_radioPollTime_def = 500;  // slowest poll, radio idle (PTT seen this late at worst)
+const QString s_radioPollFloor[NRIG]={"radios/radioPollFloor_1","radios/radioPollFloor_2",
+                                      "radios/radioPollFloor_3","radios/radioPollFloor_4",
+                                      "radios/radioPollFloor_5","radios/radioPollFloor_6",
+                                      "radios/radioPollFloor_7","radios/radioPollFloor_8" };
+const int s_radioPollFloor_def = 50; // fastest poll, radio changing
+const int kRadioPollMin = 10;        // ms, lowest poll floor accepted
+const QString s_radioTransceive[NRIG]={"radios/radioTransceive_1","radios/radioTransceive_2",
+                                       "radios/radioTransceive_3","radios/radioTransceive_4",
+                                       "radios/radioTransceive_5","radios/radioTransceive_6",
+                                       "radios/radioTransceive_7","radios/radioTransceive_8" };
+const bool s_radioTransceive_def = false; // hamlib RIG_TRN_RIG events
+const QString s_rigctldDepth[NRIG]={"radios/rigctldDepth_1","radios/rigctldDepth_2",
+                                    "radios/rigctldDepth_3","radios/rigctldDepth_4",
+                                    "radios/rigctldDepth_5","radios/rigctldDepth_6",
+                                    "radios/rigctldDepth_7","radios/rigctldDepth_8" };
+const int s_rigctldDepth_def = 2; // poll batches in flight
+const QString s_rigctldTimeout[NRIG]={"radios/rigctldTimeout_1","radios/rigctldTimeout_2",
+                                      "radios/rigctldTimeout_3","radios/rigctldTimeout_4",
+                                      "radios/rigctldTimeout_5","radios/rigctldTimeout_6",
+                                      "radios/rigctldTimeout_7","radios/rigctldTimeout_8" };
+const int s_rigctldTimeout_def = 1000; // ms
+const QString s_rigctldExtraCmds[NRIG]={"radios/rigctldExtraCmds_1","radios/rigctldExtraCmds_2",
+                                        "radios/rigctldExtraCmds_3","radios/rigctldExtraCmds_4",
+                                        "radios/rigctldExtraCmds_5","radios/rigctldExtraCmds_6",
+                                        "radios/rigctldExtraCmds_7","radios/rigctldExtraCmds_8" };
+const QString s_rigctldExtraCmds_def = ""; // ie "get_mode get_vfo get_split_vfo"
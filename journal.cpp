@@ -0,0 +1,160 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#include "journal.hpp"
+
+#include <QDateTime>
+#include <chrono>
+#include <cstring>
+
+Journal::Journal()
+{
+  header = nullptr;
+  records = nullptr;
+  segment = 0;
+}
+
+Journal::~Journal()
+{
+  close();
+}
+
+/*! continue the last segment in directory path, or start the first
+*/
+bool Journal::open(const QString &path)
+{
+  close();
+  dir = QDir(path);
+  if (!dir.mkpath(".")) return false;
+
+  QStringList list = segments(path);
+  if (list.isEmpty()) {
+    return openSegment(0, 0);
+  }
+  segment = list.last().mid(8, 6).toInt();
+  // sequence numbers continue from the newest readable segment, a damaged
+  // (or older version) last segment is left alone and a new one started
+  for (int i=list.size()-1; i>=0; --i) {
+    JournalSegment last;
+    if (!last.open(dir.absoluteFilePath(list.at(i)))) continue;
+    quint64 next = last.firstSeq() + last.count();
+    if (i == list.size() - 1 && last.count() < kJournalCapacity) {
+      return openSegment(segment, next);
+    }
+    return openSegment(segment + 1, next);
+  }
+  return openSegment(segment + 1, 0);
+}
+
+void Journal::close()
+{
+  if (header) {
+    file.unmap(reinterpret_cast<uchar *>(header));
+    header = nullptr;
+    records = nullptr;
+  }
+  file.close();
+}
+
+/*! map segment n, created (holding nothing) if it doesn't exist
+*/
+bool Journal::openSegment(int n, quint64 firstSeq)
+{
+  close();
+  segment = n;
+  file.setFileName(dir.absoluteFilePath(QString("journal-%1.srxj").arg(n, 6, 10, QChar('0'))));
+  bool exists = file.exists();
+  qint64 size = qint64(sizeof(JournalHeader)) + qint64(kJournalCapacity) * sizeof(JournalRecord);
+  if (!file.open(QIODevice::ReadWrite)) return false;
+  if (file.size() != size && !file.resize(size)) {
+    file.close();
+    return false;
+  }
+  uchar *map = file.map(0, size);
+  if (!map) {
+    file.close();
+    return false;
+  }
+  header = reinterpret_cast<JournalHeader *>(map);
+  records = reinterpret_cast<JournalRecord *>(map + sizeof(JournalHeader));
+  if (!exists || std::memcmp(header->magic, kJournalMagic, 4) != 0) {
+    std::memset(header, 0, sizeof(JournalHeader));
+    std::memcpy(header->magic, kJournalMagic, 4);
+    header->version = kJournalVersion;
+    header->recordSize = sizeof(JournalRecord);
+    header->capacity = kJournalCapacity;
+    header->count.store(0, std::memory_order_relaxed);
+    header->firstSeq = firstSeq;
+    header->created = QDateTime::currentMSecsSinceEpoch();
+  }
+  return true;
+}
+
+void Journal::append(int radio, int cause, int band, int group, int antenna, int port, int bearing)
+{
+  if (!header) return;
+  quint32 count = header->count.load(std::memory_order_relaxed); // only writer
+  if (count >= header->capacity) {
+    if (!openSegment(segment + 1, header->firstSeq + count)) return;
+    count = 0;
+  }
+  JournalRecord &r = records[count];
+  r.mono = monotonicNs();
+  r.wall = QDateTime::currentMSecsSinceEpoch();
+  r.reserved = 0;
+  r.radio = quint8(radio);
+  r.cause = quint8(cause);
+  r.bearing = qint16(bearing);
+  r.band = qint16(band);
+  r.group = qint16(group);
+  r.antenna = qint16(antenna);
+  r.port = qint16(port);
+  header->count.store(count + 1, std::memory_order_release); // record complete before it is counted
+}
+
+/*! segment file names in directory path, oldest first
+*/
+QStringList Journal::segments(const QString &path)
+{
+  return QDir(path).entryList(QStringList() << "journal-??????.srxj", QDir::Files, QDir::Name);
+}
+
+qint64 Journal::monotonicNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+JournalSegment::JournalSegment()
+{
+  header = nullptr;
+  records = nullptr;
+}
+
+JournalSegment::~JournalSegment()
+{
+  if (header) file.unmap(const_cast<uchar *>(reinterpret_cast<const uchar *>(header)));
+  file.close();
+}
+
+bool JournalSegment::open(const QString &name)
+{
+  file.setFileName(name);
+  if (!file.open(QIODevice::ReadOnly)) return false;
+  if (file.size() < qint64(sizeof(JournalHeader))) return false;
+  const uchar *map = file.map(0, file.size());
+  if (!map) return false;
+  const JournalHeader *h = reinterpret_cast<const JournalHeader *>(map);
+  if (std::memcmp(h->magic, kJournalMagic, 4) != 0 || h->version != kJournalVersion ||
+      h->recordSize != sizeof(JournalRecord) ||
+      qint64(sizeof(JournalHeader)) + qint64(h->capacity) * h->recordSize > file.size() ||
+      h->count.load(std::memory_order_acquire) > h->capacity) {
+    file.unmap(const_cast<uchar *>(map));
+    return false;
+  }
+  header = h;
+  records = reinterpret_cast<const JournalRecord *>(map + sizeof(JournalHeader));
+  return true;
+}
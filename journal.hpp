@@ -0,0 +1,113 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#pragma once
+
+// shared with tools/journalreader, QtCore only
+#include <QDir>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+
+// why an antenna was switched
+const int kCauseOther = 0;    // GUI, settings, startup
+const int kCauseCat = 1;      // band change from CAT
+const int kCauseCron = 2;
+const int kCauseClient = 3;   // websocket client action
+const int kCauseTracking = 4; // following a tracked radio
+const int kCauseScan = 5;
+const int kNCauses = 6;
+const char *const kCauseNames[kNCauses] = { "other", "cat", "cron", "client", "tracking", "scan" };
+
+/*!
+   Switching journal, append only segment files of fixed size records,
+   native byte order. A segment is journal-NNNNNN.srxj in the journal
+   directory: a JournalHeader followed by room for capacity records, the
+   file is memory mapped and records are written in place. count in the
+   header is stored (release) after each record and loaded (acquire) by
+   readers, which trust only that many; a reader on the live segment never
+   sees a half written record. The sequence number of a record is
+   firstSeq + its index, it keeps counting across segments.
+ */
+struct JournalHeader {
+    char magic[4];        // "SRXJ"
+    quint16 version;
+    quint16 recordSize;
+    quint32 capacity;     // records the segment has room for
+    std::atomic<quint32> count; // records written, see above
+    quint64 firstSeq;     // sequence number of the first record
+    qint64 created;       // ms since epoch
+    char reserved[32];
+};
+
+struct JournalRecord {
+    qint64 mono;          // ns, monotonic clock (since boot)
+    qint64 wall;          // ms since epoch
+    quint32 reserved;
+    quint8 radio;         // 0..NRIG-1
+    quint8 cause;         // kCause...
+    qint16 bearing;       // -1 none
+    qint16 band;          // ids, 0 none
+    qint16 group;
+    qint16 antenna;
+    qint16 port;          // switch port, 0 none
+};
+
+static_assert(sizeof(JournalHeader) == 64, "journal header layout");
+static_assert(sizeof(JournalRecord) == 32, "journal record layout");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "journal count is shared through the mapping");
+
+const char kJournalMagic[4] = { 'S', 'R', 'X', 'J' };
+const quint16 kJournalVersion = 2;   // 2: seq no longer stored, firstSeq + index
+const quint32 kJournalCapacity = 65536; // records per segment, 2 MB
+
+/*!
+   writer, used from the GUI thread only
+ */
+class Journal
+{
+public:
+    Journal();
+    ~Journal();
+    bool open(const QString &);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+    void append(int radio, int cause, int band, int group, int antenna, int port, int bearing);
+
+    static QStringList segments(const QString &);
+    static qint64 monotonicNs();
+
+private:
+    bool openSegment(int, quint64);
+
+    QDir dir;
+    QFile file;
+    JournalHeader *header;
+    JournalRecord *records;
+    int segment;
+};
+
+/*!
+   read only view of one segment
+ */
+class JournalSegment
+{
+public:
+    JournalSegment();
+    ~JournalSegment();
+    bool open(const QString &);
+    quint32 count() const { return header ? header->count.load(std::memory_order_acquire) : 0; }
+    quint64 firstSeq() const { return header ? header->firstSeq : 0; }
+    quint64 seq(const JournalRecord *r) const { return firstSeq() + quint64(r - records); }
+    const JournalRecord &at(quint32 i) const { return records[i]; }
+    const JournalRecord *begin() const { return records; }
+    const JournalRecord *end() const { return records + count(); }
+
+private:
+    QFile file;
+    const JournalHeader *header;
+    const JournalRecord *records;
+};
@@ -0,0 +1,224 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#include "logger.hpp"
+
+/*! "[hh:mm:ss][radio][peer] text"
+*/
+QString LogEntry::line() const
+{
+  QString s = "[" + QDateTime::fromMSecsSinceEpoch(time).toString("hh:mm:ss") + "]";
+  if (radio >= 0) s += QString("[%1]").arg(radio + 1);
+  if (!peer.isEmpty()) s += "[" + peer + "]";
+  return s + " " + text;
+}
+
+Logger::Logger(const QString &dir, bool toFile)
+{
+  ring = new Slot[kLogRingSize];
+  for (int i=0; i<kLogRingSize; ++i) {
+    ring[i].seq.store(i, std::memory_order_relaxed);
+  }
+  head = 0;
+  tail = 0;
+  nDropped = 0;
+  reportedDropped = 0;
+  this->dir = dir;
+  this->toFile = toFile;
+  for (int i=0; i<kNLogs; ++i) {
+    fileSizes[i] = 0;
+  }
+  drainTimer = new QTimer(this); // moved to the writer thread along with this
+  drainTimer->setInterval(100);
+  connect(drainTimer, &QTimer::timeout, this, &Logger::drain);
+}
+
+Logger::~Logger()
+{
+  drain();
+  for (int i=0; i<kNLogs; ++i) {
+    files[i].close();
+  }
+  delete[] ring;
+}
+
+/*! called in the writer thread once it runs
+*/
+void Logger::start()
+{
+  if (toFile && QDir().mkpath(dir)) {
+    for (int i=0; i<kNLogs; ++i) {
+      files[i].setFileName(QDir(dir).absoluteFilePath(kLogNames[i] + ".log"));
+      // no Text, lines are UTF-8 ending in \n already and the bytes counted
+      // for rotation must be the bytes on disk
+      if (files[i].open(QIODevice::WriteOnly | QIODevice::Append)) {
+        fileSizes[i] = files[i].size();
+      }
+    }
+  }
+  drainTimer->start();
+}
+
+bool Logger::log(int log, const QString &text, int radio, const QString &peer)
+{
+  LogEntry entry;
+  entry.time = QDateTime::currentMSecsSinceEpoch();
+  entry.log = log;
+  entry.radio = radio;
+  entry.peer = peer;
+  entry.text = text;
+  return push(entry);
+}
+
+/*! websocket frame, only formatted for display in the writer thread
+*/
+bool Logger::logFrame(int log, const QByteArray &data, bool cbor, int radio, const QString &peer)
+{
+  LogEntry entry;
+  entry.time = QDateTime::currentMSecsSinceEpoch();
+  entry.log = log;
+  entry.radio = radio;
+  entry.peer = peer;
+  entry.cbor = cbor;
+  entry.data = data;
+  return push(entry);
+}
+
+/*! claim the next slot, a slot is free when its seq equals the position
+  being claimed and readable when it is one past
+*/
+bool Logger::push(LogEntry &entry)
+{
+  quint64 pos = head.load(std::memory_order_relaxed);
+  Slot *slot;
+  for (;;) {
+    slot = &ring[pos & (kLogRingSize - 1)];
+    quint64 seq = slot->seq.load(std::memory_order_acquire);
+    qint64 diff = qint64(seq - pos);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) { // full, writer is a whole ring behind
+      nDropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = head.load(std::memory_order_relaxed);
+    }
+  }
+  slot->entry = std::move(entry);
+  slot->seq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+/*! take everything logged so far, write it out and pass it on
+*/
+void Logger::drain()
+{
+  QVector<LogEntry> batch;
+  for (;;) {
+    Slot *slot = &ring[tail & (kLogRingSize - 1)];
+    if (slot->seq.load(std::memory_order_acquire) != tail + 1) break;
+    LogEntry entry = std::move(slot->entry);
+    slot->entry = LogEntry();
+    slot->seq.store(tail + kLogRingSize, std::memory_order_release);
+    ++tail;
+
+    if (!entry.data.isEmpty()) {
+      formatFrame(entry);
+    }
+    write(entry);
+    batch << entry;
+  }
+
+  quint64 dropped = nDropped.load(std::memory_order_relaxed);
+  if (dropped != reportedDropped) {
+    LogEntry entry;
+    entry.time = QDateTime::currentMSecsSinceEpoch();
+    entry.log = kLogServer;
+    entry.text = QString("%1 log entries dropped").arg(dropped - reportedDropped);
+    reportedDropped = dropped;
+    write(entry);
+    batch << entry;
+  }
+
+  if (!batch.isEmpty()) {
+    for (int i=0; i<kNLogs; ++i) {
+      if (files[i].isOpen()) files[i].flush();
+    }
+    emit(entries(batch));
+  }
+}
+
+/*! text and type of a websocket frame or RS485 line. the type is the
+  object names of the updates in a frame, or the action of a client
+  message
+*/
+void Logger::formatFrame(LogEntry &entry)
+{
+  QStringList types;
+  auto addType = [&types](const QString &type) {
+    if (!type.isEmpty() && !types.contains(type)) types << type;
+  };
+  if (entry.cbor) {
+    QCborValue frame = QCborValue::fromCbor(entry.data);
+    entry.text = frame.toDiagnosticNotation();
+    const QCborArray updates = frame.isArray() ? frame.toArray() : QCborArray{ frame };
+    for (const auto &update : updates) {
+      QCborMap map = update.toMap();
+      if (map.contains(0)) {
+        addType(kWsObjects.value(int(map.value(0).toInteger())));
+      } else {
+        addType(map.value(QStringLiteral("object")).toString());
+        addType(map.value(QStringLiteral("action")).toString());
+      }
+    }
+  } else {
+    entry.text = QString::fromUtf8(entry.data).simplified();
+    if (entry.data.startsWith('{') || entry.data.startsWith('[')) {
+      QJsonDocument doc = QJsonDocument::fromJson(entry.data);
+      const QJsonArray updates = doc.isArray() ? doc.array() : QJsonArray{ doc.object() };
+      for (const auto &update : updates) {
+        addType(update.toObject().value("object").toString());
+        addType(update.toObject().value("action").toString());
+      }
+    } else { // RS485, first word
+      addType(entry.text.section(' ', 0, 0));
+    }
+  }
+  entry.type = types.join(',');
+  entry.data.clear();
+}
+
+void Logger::write(const LogEntry &entry)
+{
+  QFile &file = files[entry.log];
+  if (!file.isOpen()) return;
+  // full date in the files, they outlive a day
+  QByteArray line = (QDateTime::fromMSecsSinceEpoch(entry.time).toString("yyyy-MM-dd ")
+                     + entry.line() + "\n").toUtf8();
+  if (fileSizes[entry.log] + line.size() > kLogFileSize) {
+    rotate(entry.log);
+    if (!file.isOpen()) return;
+  }
+  qint64 n = file.write(line);
+  if (n > 0) fileSizes[entry.log] += n;
+}
+
+/*! name.log -> name.log.1 -> ... name.log.kLogFiles, oldest removed
+*/
+void Logger::rotate(int log)
+{
+  QFile &file = files[log];
+  QString name = file.fileName();
+  file.close();
+  QFile::remove(name + "." + QString::number(kLogFiles));
+  for (int i=kLogFiles-1; i>0; --i) {
+    QFile::rename(name + "." + QString::number(i), name + "." + QString::number(i + 1));
+  }
+  QFile::rename(name, name + ".1");
+  fileSizes[log] = 0;
+  if (file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+    fileSizes[log] = file.size(); // 0 unless the rename failed
+  }
+}
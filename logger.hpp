@@ -0,0 +1,76 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#pragma once
+
+#include "defines.hpp"
+
+/*!
+   one log line, timestamp taken when logged, text formatted by the writer
+ */
+struct LogEntry {
+    qint64 time = 0;   // ms since epoch
+    qint8 log = 0;     // kLogSerial...
+    qint8 radio = -1;  // 0..NRIG-1, -1 none
+    bool cbor = false; // data is a CBOR frame, UTF-8 otherwise
+    QString peer;      // client "address:port", empty none
+    QString type;      // frame objects or client action, set by the writer
+    QString text;
+    QByteArray data;   // frame, formatted into text by the writer
+
+    QString line() const;
+};
+Q_DECLARE_METATYPE(QVector<LogEntry>)
+
+/*!
+   Log pipeline. log() may be called from any thread, it only claims a
+   slot in a fixed size ring (multi-producer, single consumer, no locks)
+   and never blocks; when the ring is full the entry is dropped and
+   counted.
+
+   The Logger itself runs in its own QThread, drains the ring periodically,
+   formats the entries, appends them to the rotating files and hands them
+   to the GUI in batches.
+ */
+class Logger : public QObject
+{
+Q_OBJECT
+
+public:
+    Logger(const QString &dir, bool toFile);
+    ~Logger();
+    bool log(int, const QString &, int radio = -1, const QString &peer = QString());
+    bool logFrame(int, const QByteArray &, bool, int radio = -1, const QString &peer = QString());
+    quint64 dropped() const { return nDropped.load(std::memory_order_relaxed); }
+
+signals:
+    void entries(const QVector<LogEntry> &);
+
+public slots:
+    void start();
+    void drain();
+
+private:
+    struct Slot {
+        std::atomic<quint64> seq;
+        LogEntry entry;
+    };
+
+    bool push(LogEntry &);
+    void write(const LogEntry &);
+    void rotate(int);
+    static void formatFrame(LogEntry &);
+
+    Slot *ring;
+    std::atomic<quint64> head;  // next slot to claim, producers
+    quint64 tail;               // next slot to read, writer thread only
+    std::atomic<quint64> nDropped;
+    quint64 reportedDropped;
+    QTimer *drainTimer;
+    QString dir;
+    bool toFile;
+    QFile files[kNLogs];
+    qint64 fileSizes[kNLogs];   // bytes written so far, no stat per line
+};
@@ -0,0 +1,111 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#include "logmodel.hpp"
+
+LogModel::LogModel(int capacity, QObject *parent) : QAbstractListModel(parent)
+{
+  this->capacity = capacity;
+  ring.resize(capacity);
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+  if (parent.isValid()) return 0;
+  return rows.size();
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= rows.size()) return QVariant();
+  if (role == Qt::DisplayRole) {
+    return entry(rows.at(index.row())).line();
+  } else if (role == Qt::ToolTipRole) {
+    return QDateTime::fromMSecsSinceEpoch(entry(rows.at(index.row())).time).toString("yyyy-MM-dd hh:mm:ss.zzz");
+  }
+  return QVariant();
+}
+
+/*! add a batch of entries, oldest entries leave the ring (and their rows)
+  as new ones come in. cost is per entry added, not per entry kept
+*/
+void LogModel::append(const QVector<LogEntry> &entries)
+{
+  int n = entries.size();
+  if (!n) return;
+  int skip = qMax(n - capacity, 0); // overwritten within this batch
+  quint64 end = next + n;
+  quint64 oldest = (end > quint64(capacity)) ? end - capacity : 0;
+
+  int evicted = 0;
+  while (evicted < rows.size() && rows.at(evicted) < oldest) ++evicted;
+  if (evicted) {
+    beginRemoveRows(QModelIndex(), 0, evicted - 1);
+    rows.erase(rows.begin(), rows.begin() + evicted);
+    endRemoveRows();
+  }
+
+  QList<quint64> added;
+  for (int i=skip; i<n; ++i) {
+    quint64 seq = next + i;
+    ring[int(seq % quint64(capacity))] = entries.at(i);
+    if (matches(entries.at(i))) added << seq;
+  }
+  next = end;
+
+  if (!added.isEmpty()) {
+    beginInsertRows(QModelIndex(), rows.size(), rows.size() + added.size() - 1);
+    rows += added;
+    endInsertRows();
+  }
+}
+
+void LogModel::setFilter(const QString &text)
+{
+  Filter f;
+  for (const QString &term : text.simplified().split(' ')) {
+    if (term.isEmpty()) {
+      continue;
+    } else if (term.startsWith("radio:") || term.startsWith("r:")) {
+      bool ok;
+      int radio = term.section(':', 1).toInt(&ok);
+      if (ok) f.radio = radio - 1;
+    } else if (term.startsWith("peer:")) {
+      f.peer << term.mid(5);
+    } else if (term.startsWith('@')) {
+      f.peer << term.mid(1);
+    } else if (term.startsWith("type:")) {
+      f.type << term.mid(5);
+    } else if (term.startsWith("t:")) {
+      f.type << term.mid(2);
+    } else {
+      f.text << term;
+    }
+  }
+
+  beginResetModel();
+  filter = f;
+  rows.clear();
+  quint64 oldest = (next > quint64(capacity)) ? next - capacity : 0;
+  for (quint64 seq=oldest; seq<next; ++seq) {
+    if (matches(entry(seq))) rows << seq;
+  }
+  endResetModel();
+}
+
+bool LogModel::matches(const LogEntry &e) const
+{
+  if (filter.radio >= 0 && e.radio != filter.radio) return false;
+  for (const QString &s : filter.peer) {
+    if (!e.peer.contains(s)) return false;
+  }
+  for (const QString &s : filter.type) {
+    if (!e.type.contains(s, Qt::CaseInsensitive)) return false;
+  }
+  for (const QString &s : filter.text) {
+    if (!e.text.contains(s, Qt::CaseInsensitive)) return false;
+  }
+  return true;
+}
@@ -0,0 +1,49 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#pragma once
+
+#include "defines.hpp"
+#include "logger.hpp"
+
+/*!
+   Last entries of one log for a QListView. Entries are kept in a fixed
+   ring, rows are the ring entries passing the filter and are only turned
+   into text when the view asks for them (visible rows).
+
+   Filter is space separated terms, all must match:
+     radio:N  (r:N)   entries for radio N
+     peer:x   (@x)    client address containing x
+     type:x   (t:x)   message type (frame object or action) containing x
+     other            text containing it
+ */
+class LogModel : public QAbstractListModel
+{
+Q_OBJECT
+
+public:
+    explicit LogModel(int capacity, QObject *parent = nullptr);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    void append(const QVector<LogEntry> &);
+    void setFilter(const QString &);
+
+private:
+    struct Filter {
+        int radio = -1;
+        QStringList peer;
+        QStringList type;
+        QStringList text;
+    };
+
+    bool matches(const LogEntry &) const;
+    const LogEntry &entry(quint64 seq) const { return ring.at(int(seq % quint64(capacity))); }
+
+    QVector<LogEntry> ring;
+    int capacity;
+    quint64 next = 0;     // sequence number of the next entry
+    QList<quint64> rows;  // sequence numbers of the entries shown, ascending
+    Filter filter;
+};
@@ -20,9 +20,38 @@ MainWindow::MainWindow(QWidget *parent)
   db = QSqlDatabase::addDatabase ("QSQLITE");
   openDatabase();
   initDatabase();
+  topology.load(db);
 
   // settings
   settings = new QSettings("softrx", "settings");
+
+  // logs, formatted and written in their own thread
+  qRegisterMetaType<QVector<LogEntry>>("QVector<LogEntry>");
+  logViews[kLogSerial] = serialLog;
+  logViews[kLogJson] = jsonLog;
+  logViews[kLogCron] = cronLog;
+  logViews[kLogServer] = serverLog;
+  logFilters[kLogSerial] = serialLogFilter;
+  logFilters[kLogJson] = jsonLogFilter;
+  logFilters[kLogCron] = cronLogFilter;
+  logFilters[kLogServer] = serverLogFilter;
+  for (int i=0; i<kNLogs; ++i) {
+    logModels[i] = new LogModel(kLogTailSize, this);
+    logViews[i]->setModel(logModels[i]);
+    connect(logFilters[i], &QLineEdit::textChanged, logModels[i], &LogModel::setFilter);
+  }
+  logThread = new QThread;
+  logger = new Logger(QDir(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)).absoluteFilePath("logs"),
+                      settings->value("logToFile", logToFile_def).toBool());
+  logger->moveToThread(logThread);
+  connect(logThread, &QThread::started, logger, &Logger::start);
+  connect(logThread, &QThread::finished, logger, &QObject::deleteLater);
+  connect(logger, &Logger::entries, this, &MainWindow::logEntries, Qt::QueuedConnection);
+  logThread->start();
+  if (settings->value("journal", journal_def).toBool() &&
+      !journal.open(QDir(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)).absoluteFilePath("journal"))) {
+    logger->log(kLogServer, "Switching journal could not be opened");
+  }
   //restore main window geometry and state
   restoreGeometry(settings->value("geometry").toByteArray());
   restoreState(settings->value("windowState").toByteArray());
@@ -78,10 +107,33 @@ MainWindow::MainWindow(QWidget *parent)
   }
   for (int i=0;i<NRIG;++i) {
     connect(qApp, &QApplication::aboutToQuit, cat[i], &RigSerial::stopSerial);
-  }
-
-  // rs485
-  rs485Serial = new QSerialPort();
+    // CAT changes arrive queued from the radio threads, take one
+    // consistent snapshot of the radio on each
+    auto catChanged = [=]() {
+      catState[i] = cat[i]->rigState();
+      updateRadioStates();
+    };
+    connect(cat[i], &RigSerial::frequencyChanged, this, catChanged, Qt::QueuedConnection);
+    connect(cat[i], &RigSerial::pttChanged, this, catChanged, Qt::QueuedConnection);
+    connect(cat[i], &RigSerial::connectionChanged, this, catChanged, Qt::QueuedConnection);
+    connect(&scanTimer[i], &QTimer::timeout, this, [=]() { timeoutScanTimer(i); });
+    bearingTimer[i].setSingleShot(true);
+    connect(&bearingTimer[i], &QTimer::timeout, this, [=]() { applyPendingBearing(i); });
+  }
+
+  // rs485, port owned by its I/O thread
+  rs485Thread = new QThread;
+  rs485IO = new Rs485IO(logger);
+  rs485IO->moveToThread(rs485Thread);
+  connect(rs485Thread, &QThread::finished, rs485IO, &QObject::deleteLater);
+  connect(this, &MainWindow::rs485Open, rs485IO, &Rs485IO::open, Qt::QueuedConnection);
+  connect(this, &MainWindow::rs485Close, rs485IO, &Rs485IO::close, Qt::QueuedConnection);
+  connect(rs485IO, &Rs485IO::opened, this, &MainWindow::rs485Opened, Qt::QueuedConnection);
+  connect(rs485IO, &Rs485IO::closed, this, &MainWindow::rs485Closed, Qt::QueuedConnection);
+  connect(rs485IO, &Rs485IO::sent, this, &MainWindow::rs485Sent, Qt::QueuedConnection);
+  connect(rs485IO, &Rs485IO::sendFailed, this, &MainWindow::rs485SendFailed, Qt::QueuedConnection);
+  connect(rs485IO, &Rs485IO::received, this, &MainWindow::rs485RcvdData, Qt::QueuedConnection);
+  rs485Thread->start();
   rs485Button->setText("Connect");
   connect(rs485Button, &QPushButton::released, this, &MainWindow::rs485Connection);
   rs485RcvdDataLabel = new QLabel("");
@@ -130,7 +182,8 @@ MainWindow::MainWindow(QWidget *parent)
     currentPtt[i] = false;
     currentGain[i] = 0;
     currentScanDelay[i] = settings->value(s_radioScanDelay[i], s_radioScanDelay_def).toInt();
-    scanCount[i] = 0;
+    scanPaused[i] = false;
+    pendingBearing[i] = -1;
     setAntennaLock(i, false);
     scanState[i] = false;
     trackingState[i] = false;
@@ -148,24 +201,30 @@ MainWindow::MainWindow(QWidget *parent)
   }
 
   connect(pbRestartWebSocket, &QPushButton::released, this, &MainWindow::restartWebSocketServer);
-  webSocketServer = new QWebSocketServer(QStringLiteral("softrx"),
-                                          QWebSocketServer::NonSecureMode,
-                                          this);
-  if ( webSocketServer->listen(QHostAddress::Any, settings->value("websocketPort", websocketPort_def).toInt())) {
-    //qDebug() << "websocket server listening "+settings->value("websocketPort", websocketPort_def).toString();
-    statusBarUi->showMessage(QString("Websocket server listening on port %1")
-                             .arg(settings->value("websocketPort",websocketPort_def).toString()),
-                             5000);
-    serverLog->appendPlainText(QString("[%1] Websocket server started on port %2")
-                             .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                             .arg(settings->value("websocketPort",websocketPort_def).toString()));
-    connect(webSocketServer, &QWebSocketServer::newConnection, this, &MainWindow::onNewConnection);
-  }
-
-    // start timer after everything else is setup
-  connect(&mainTimer, &QTimer::timeout, this, &MainWindow::timeoutMainTimer);
-  mainTimer.start(timerPeriod);
-  //qDebug() << "MainWindow timer thread " << mainTimer.thread();
+  connect(&rigctldStatsTimer, &QTimer::timeout, this, &MainWindow::rigctldStats);
+  rigctldStatsTimer.start(kRigctldStatsInterval);
+  bearingInterval = settings->value("bearingInterval", bearingInterval_def).toInt();
+  // websocket I/O in its own thread, all traffic through queued connections
+  wsThread = new QThread;
+  wsIO = new WebSocketIO(settings->value("websocketHighWater", websocketHighWater_def).toInt(),
+                         settings->value("websocketMaxQueue", websocketMaxQueue_def).toInt(),
+                         settings->value("websocketStallTime", websocketStallTime_def).toInt());
+  wsIO->moveToThread(wsThread);
+  connect(wsThread, &QThread::finished, wsIO, &QObject::deleteLater);
+  connect(this, &MainWindow::wsListen, wsIO, &WebSocketIO::listen, Qt::QueuedConnection);
+  connect(this, &MainWindow::wsSend, wsIO, &WebSocketIO::send, Qt::QueuedConnection);
+  connect(wsIO, &WebSocketIO::listening, this, &MainWindow::serverListening, Qt::QueuedConnection);
+  connect(wsIO, &WebSocketIO::clientConnected, this, &MainWindow::clientConnected, Qt::QueuedConnection);
+  connect(wsIO, &WebSocketIO::clientDisconnected, this, &MainWindow::socketDisconnected, Qt::QueuedConnection);
+  connect(wsIO, &WebSocketIO::messageReceived, this, &MainWindow::processMessage, Qt::QueuedConnection);
+  connect(wsIO, &WebSocketIO::slowClient, this, &MainWindow::slowClient, Qt::QueuedConnection);
+  connect(wsIO, &WebSocketIO::framesDropped, this, &MainWindow::framesDropped, Qt::QueuedConnection);
+  wsThread->start();
+  emit(wsListen(settings->value("websocketPort", websocketPort_def).toInt()));
+
+  // initial radio state after everything else is setup, updated on CAT
+  // events from here on
+  updateRadioStates();
 
   // = end constructor
 }
@@ -176,8 +235,7 @@ void MainWindow::cronStart()
   QSqlQuery query(db);
   query.exec("SELECT * from cron where enabled = 1");
   std::time_t now = std::time(0);
-  cronLog->appendPlainText(QString("[%1] Cron started")
-                            .arg(QDateTime::currentDateTime().toString("hh:mm:ss")));
+  logger->log(kLogCron, "Cron started");
   while (query.next()) {
     int id = query.value("id").toInt();
     std::time_t next;
@@ -190,9 +248,8 @@ void MainWindow::cronStart()
     catch (cron::bad_cronexpr const & ex)
     {
       qDebug() << ex.what();
-      cronLog->appendPlainText(QString("[%1] Cron(%2) bad expression")
-                                .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                .arg(id));
+      logger->log(kLogCron, QString("Cron(%1) bad expression")
+                             .arg(id));
       continue;
     }
 
@@ -213,9 +270,8 @@ void MainWindow::cronStart()
     while (cronTableModel->canFetchMore()) {
       cronTableModel->fetchMore();
     }
-    cronLog->appendPlainText(QString("[%1] Cronjob(%2) added")
-                                .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                .arg(id));
+    logger->log(kLogCron, QString("Cronjob(%1) added")
+                           .arg(id));
   }
   //qDebug() << "Cron started";
   statusBarUi->showMessage("Cron started", tmpStatusMsgDelay);
@@ -239,8 +295,7 @@ void MainWindow::cronStop()
   while (cronTableModel->canFetchMore()) {
     cronTableModel->fetchMore();
   }
-  cronLog->appendPlainText(QString("[%1] Cron stopped")
-                              .arg(QDateTime::currentDateTime().toString("hh:mm:ss")));
+  logger->log(kLogCron, "Cron stopped");
 }
 
 void MainWindow::cronExecute(int cronId)
@@ -257,56 +312,32 @@ void MainWindow::cronExecute(int cronId)
     //qDebug() << "Radio " << radio << " Antenna " << antenna;
     int coChannelPort = getSwitchPort(currentAntenna[coChannel[radio]]);
 
-    QSqlQuery queryAntenna(db);
-    QString sqlAntenna;
-    sqlAntenna.append(QString("SELECT * from antennas where id = %1"
-                              " and enabled = 1 and switch_port <> %2")
-                              .arg(antenna)
-                              .arg(coChannelPort) );
-    //sqlAntenna.append(QString(" and enabled = 1 and switch_port <> %1").arg(coChannelPort));
-    if (radio < 4) {
-      sqlAntenna.append(" and radios1_4 = 1");
-    } else {
-      sqlAntenna.append(" and radios5_8 = 1");
-    }
-    queryAntenna.exec(sqlAntenna);
-    if (queryAntenna.first()) { // antenna found and valid
+    const Topology::Antenna *ant = topology.antenna(antenna);
+    if (ant && ant->enabled && ant->switch_port != coChannelPort &&
+        (radio < 4 ? ant->radios1_4 : ant->radios5_8)) { // antenna found and valid
       //qDebug() << "antenna found";
-      QString sqlGroup,match,sort,extra;
-      if (radio < 4) {
-        match.append(" and groups.radios1_4 = 1");
-      } else {
-        match.append(" and groups.radios5_8 = 1");
+      const Topology::Group *grp = nullptr;
+      for (int id : topology.groupsForBand(currentBand[radio], radio)) {
+        if (topology.antennasByPriority(id, radio).contains(antenna)) {
+          grp = topology.group(id); // highest priority
+          break;
+        }
       }
-      match.append(QString(" and antennas.id = %1")
-                        .arg(antenna));
-      sort.append(" order by groups.priority desc, groups.id desc");
-      extra.append(" inner join group_antenna_map on group_antenna_map.group_id = groups.id"
-                   " inner join antennas on antennas.id = group_antenna_map.antenna_id");
-      sqlGroup.append(kSelectGroupSQL.arg(currentBand[radio])
-                                     .arg(match)
-                                     .arg(sort)
-                                     .arg(extra) );
-
-      //qDebug() << sqlGroup;
-      QSqlQuery queryGroup(db);
-      queryGroup.exec(sqlGroup);
-      if (queryGroup.first()) { // found a group, highest priority
-        //qDebug() << "group found " << queryGroup.value("id").toInt();
+      if (grp) { // found a group, highest priority
+        //qDebug() << "group found " << grp->id;
         setAntennaLock(radio, false);
         setAntennaScanning(radio, false);
         setAntennaTracking(radio, false);
-        int display_mode = queryGroup.value("display_mode").toInt();
-        int bearing = calcCenterBearing(queryAntenna.value("start_deg").toInt(),
-                                        queryAntenna.value("stop_deg").toInt());
+        int display_mode = grp->display_mode;
+        int bearing = calcCenterBearing(ant->start_deg, ant->stop_deg);
         if (currentBearing[radio] != bearing) {
           currentBearing[radio] = bearing;
           bearingChanged(radio);
         }
-        if (currentGroup[radio] != queryGroup.value("id").toInt()) {
-          currentGroup[radio] = queryGroup.value("id").toInt();
-          radioGroupLabel[radio]->setText(queryGroup.value("label").toString());
-          cbGroupSetText(radio, queryGroup.value("label").toString());
+        if (currentGroup[radio] != grp->id) {
+          currentGroup[radio] = grp->id;
+          radioGroupLabel[radio]->setText(grp->label);
+          cbGroupSetText(radio, grp->label);
           //groupChanged(radio);
           if (display_mode == kDispList) {
             createAntennaButtons(radio);
@@ -320,7 +351,10 @@ void MainWindow::cronExecute(int cronId)
         }
         if (currentAntenna[radio] != antenna) {
           currentAntenna[radio] = antenna;
+          int cause = switchCause;
+          switchCause = kCauseCron;
           antennaChanged(radio);
+          switchCause = cause;
           /* // handled in antennaChanged
           if (display_mode == kDispList) {
             updateAntennaButtonsSelection(radio);
@@ -339,25 +373,22 @@ void MainWindow::cronExecute(int cronId)
         statusBarUi->showMessage(
           QString("Executing cronjob(%1): %2 -> %3")
               .arg(cronId)
-              .arg(settings->value(s_radioName[radio],s_radioName_def).toString())
-              .arg(queryAntenna.value("name").toString()),
+              .arg(radioConfig[radio].name)
+              .arg(ant->name),
           5000);
 
-        cronLog->appendPlainText(QString("[%1] Cronjob(%2) executed OK")
-                                    .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                    .arg(cronId));
+        logger->log(kLogCron, QString("Cronjob(%1) executed OK")
+                               .arg(cronId));
 
       } else { // group not found
-        cronLog->appendPlainText(QString("[%1] Cronjob(%2) group not found")
-                                    .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                    .arg(cronId));
+        logger->log(kLogCron, QString("Cronjob(%1) group not found")
+                               .arg(cronId));
       }
 
     } else { // antenna not found or invalid
-      cronLog->appendPlainText(QString("[%1] Cronjob(%2) antenna(%3) not found")
-                                  .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                  .arg(cronId)
-                                  .arg(antenna));
+      logger->log(kLogCron, QString("Cronjob(%1) antenna(%2) not found")
+                             .arg(cronId)
+                             .arg(antenna));
     }
 
     // setup next timer interval for this cronjob
@@ -386,9 +417,8 @@ void MainWindow::cronExecute(int cronId)
         cronTableModel->fetchMore();
       }
       timer->deleteLater();
-      cronLog->appendPlainText(QString("[%1] Cronjob(%2) bad expression")
-                                  .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                  .arg(cronId));
+      logger->log(kLogCron, QString("Cronjob(%1) bad expression")
+                             .arg(cronId));
       return;
     }
     timer->setInterval((next - now)*1000);
@@ -404,9 +434,8 @@ void MainWindow::cronExecute(int cronId)
     while (cronTableModel->canFetchMore()) {
       cronTableModel->fetchMore();
     }
-    cronLog->appendPlainText(QString("[%1] Cronjob(%2) re-queued")
-                                .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                .arg(cronId));
+    logger->log(kLogCron, QString("Cronjob(%1) re-queued")
+                           .arg(cronId));
 
   } else { // not in database, remove timer from list and delete timer
     for (int i=0; i < cronTimers.count(); ++i) {
@@ -416,9 +445,8 @@ void MainWindow::cronExecute(int cronId)
       }
     }
     timer->deleteLater();
-    cronLog->appendPlainText(QString("[%1] Cronjob(%2) not found")
-                                .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                .arg(cronId));
+    logger->log(kLogCron, QString("Cronjob(%1) not found")
+                           .arg(cronId));
   }
 
 }
@@ -426,189 +454,219 @@ void MainWindow::cronExecute(int cronId)
 void MainWindow::restartWebSocketServer()
 {
   // existing clients stay connected on original port
-  webSocketServer->close();
-  if ( webSocketServer->listen(QHostAddress::Any, settings->value("websocketPort", websocketPort_def).toInt())) {
-    //qDebug() << "websocket server listening "+settings->value("websocketPort", websocketPort_def).toString();
+  emit(wsListen(settings->value("websocketPort", websocketPort_def).toInt()));
+}
+
+/*! result of starting the websocket server in the I/O thread
+*/
+void MainWindow::serverListening(bool ok, int port, bool restart)
+{
+  if (ok) {
+    //qDebug() << "websocket server listening " << port;
     statusBarUi->showMessage(QString("Websocket server listening on port %1")
-                              .arg(settings->value("websocketPort",websocketPort_def).toString()),
+                              .arg(port),
                              5000);
-    serverLog->appendPlainText(QString("[%1] Websocket server restarted on port %2")
-                                  .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                  .arg(settings->value("websocketPort",websocketPort_def).toString()));
+    logger->log(kLogServer, QString("Websocket server %1 on port %2")
+                             .arg(restart ? "restarted" : "started")
+                             .arg(port));
   }
 }
 
-void MainWindow::processMessage(const QByteArray &message)
+void MainWindow::processMessage(quint64 pSender, const QByteArray &message)
 {
-  QWebSocket *pSender = qobject_cast<QWebSocket *>(sender());
+  if (!clientPeers.contains(pSender)) return; // gone meanwhile
+  auto client = m_clients.find(pSender); // only lookup of the sender
 
-  QJsonDocument doc = QJsonDocument::fromJson(message);
-  QJsonObject object = doc.object();
+  // binary clients may send CBOR maps, JSON is always understood
+  QJsonObject object;
+  bool fromCbor = false;
+  if (client != m_clients.end() && client->cbor) {
+    QCborValue cbor = QCborValue::fromCbor(message);
+    if (cbor.isMap()) {
+      object = cbor.toMap().toJsonObject();
+      fromCbor = true;
+    }
+  }
+  if (object.isEmpty()) {
+    object = QJsonDocument::fromJson(message).object();
+  }
 
-  // client registration
-  if (object.contains("radio")) {
-    int nrig = object.value("radio").toInt() - 1;
-    if (nrig >= 0 && nrig < 8) {
-      bool registered = false;
-      for (const auto &client : qAsConst(m_clients)) {
-        if (client.websocket == pSender) {
-          registered = true;
-        }
-      }
-      if (registered) {
-        //qDebug() << "client already registered, re-initializing";
-        serverLog->appendPlainText(QString("[%1] %2:%3 re-initializing as radio %4")
-                                      .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                      .arg(pSender->peerAddress().toString())
-                                      .arg(pSender->peerPort())
-                                      .arg(nrig + 1));
-      } else {
-        m_clients << clientinfo(pSender, nrig);
-        //qDebug() << "new client registered as radio " << nrig + 1;
-        statusBarUi->showMessage(QString("New client registered as radio %1")
-                                      .arg(nrig + 1),
-                                      tmpStatusMsgDelay);
-        serverLog->appendPlainText(QString("[%1] %2:%3 registered as radio %4")
-                                      .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                      .arg(pSender->peerAddress().toString())
-                                      .arg(pSender->peerPort())
-                                      .arg(nrig + 1));
+  // client registration, {"radio": N} for one radio or {"radios": [N, ...]}
+  // for several over one connection
+  if (!object.contains("action") && (object.contains("radio") || object.contains("radios"))) {
+    bool tagged = object.contains("radios");
+    quint32 radios = 0;
+    if (tagged) {
+      for (const auto &value : object.value("radios").toArray()) {
+        int nrig = value.toInt() - 1;
+        if (nrig >= 0 && nrig < NRIG) radios |= 1u << nrig;
       }
-      // initialize client window
-      radioNameSetText(nrig, pSender);
-      radioConnectionStatus(nrig, radioConnected[nrig], pSender); // cat[nrig]->radioOpen());
-      cbBandAddItems(nrig, pSender);
-      //updateBandComboSelection(nrig);
-      cbBandSetText(nrig, radioBandLabel[nrig]->text(), pSender);
-      cbBandSetEnabled(nrig, pSender); // not effected by lock state
-      bearingLabelText(nrig, pSender);
-
-      cbLinkedAddItems(nrig, pSender);
-      cbLinkedSetIndex(nrig, pSender);
-      cbScanDelayAddItems(nrig, pSender);
-      cbScanDelaySetIndex(nrig, pSender);
-      pbScanEnabledStatus(nrig, pSender);
-      cbGroupAddItems(nrig, pSender);
-      lbPttState(nrig, pSender);
-      lbHpfSetText(nrig, pSender);
-      lbBpfSetText(nrig, pSender);
-      lbGainSetText(nrig, pSender);
-      lbAuxSetText(nrig, pSender);
+    } else {
+      int nrig = object.value("radio").toInt() - 1;
+      if (nrig >= 0 && nrig < NRIG) radios = 1u << nrig;
+    }
+    if (radios) {
+      bool cbor = (object.value("protocol").toString() == kWsProtocolCbor);
+      subscribeClient(pSender, radios, tagged, cbor);
+    }
+    return;
+  }
 
-      int display_mode = getDisplayMode(currentGroup[nrig]);
+  if (client == m_clients.end()) return;
+  const QJsonValue action = object.value("action");
+  if (!action.isString()) return;
 
-      if (currentGroup[nrig] > 0) {
-        if (display_mode == kDispList) {
-          createAntennaButtons(nrig, pSender);
-          updateAntennaButtonsSelection(nrig, pSender);
-          setLayoutIndex(nrig, kDispList, pSender);
-        } else if (display_mode == kDispCompass) {
-          updateGraphicsLines(nrig, pSender);
-          updateGraphicsLabels(nrig, pSender);
-          updateGraphicsEllipse(nrig, pSender);
-          setLayoutIndex(nrig, kDispCompass, pSender);
-        } else {
-          setLayoutIndex(nrig, kDispNone, pSender);
-        }
-      } else {
-        setLayoutIndex(nrig, kDispNone, pSender);
-      }
-      //if (scanState[nrig]) {
-        pbScanStatus(nrig, scanState[nrig], pSender);
-      //} else if (trackingState[nrig]) {
-        pbTrackStatus(nrig, trackingState[nrig], pSender);
-      if (trackingState[nrig]) {
-        cbLinkedSetEnabled(nrig, false, pSender);
-      }
-      //} else if (lockState[nrig]) {
-        pbLockStatus(nrig, lockState[nrig], pSender);
-      if (lockState[nrig]) {
-        cbGroupSetEnabled(nrig, false, pSender);
-        pbScanSetEnabled(nrig, false, pSender);
-        pbTrackSetEnabled(nrig, false, pSender);
-        cbLinkedSetEnabled(nrig, false, pSender);
-        cbScanDelaySetEnabled(nrig, false, pSender);
-        frameSetEnabled(nrig, false, pSender);
-      }
-      // end init
+  int nrig = client->tagged ? object.value("radio").toInt() - 1 : client->radio;
+  if (nrig < 0 || nrig >= NRIG || !(client->radios & (1u << nrig))) return;
+  //qDebug() << "processMessage radio: " << nrig+1;
+  logger->logFrame(kLogServer, message, fromCbor, nrig, clientPeers.value(pSender));
 
-      // update client count
-      int cnt = 0;
-      for (const auto &client : qAsConst(m_clients)) {
-        if (client.radio == nrig) {
-          cnt++;
-        }
-      }
-      if (cnt) {
-        clientsLabel[nrig]->setText(QString::number(cnt));
-      } else {
-        clientsLabel[nrig]->setText("");
-      }
+  auto handler = actionHandlers().constFind(action.toString());
+  if (handler != actionHandlers().constEnd()) {
+    if (handler.key() != QLatin1String("bearing")) {
+      applyPendingBearings(); // keep order with other actions
     }
-    return;
+    int cause = switchCause;
+    switchCause = kCauseClient;
+    handler.value()(this, nrig, pSender, object);
+    switchCause = cause;
   }
+}
 
-  if (!object.contains("action")) return;
-  if (!object.value("action").isString()) return;
+/*! client actions by name, add new ones here
+*/
+const QHash<QString, MainWindow::actionHandler> &MainWindow::actionHandlers()
+{
+  static const QHash<QString, actionHandler> handlers = {
+    { "bearing", [](MainWindow *w, int nrig, quint64, const QJsonObject &object) {
+        w->queueBearing(nrig, object.value("degrees").toInt());
+      } },
+    { "buttonclicked", [](MainWindow *w, int nrig, quint64, const QJsonObject &object) {
+        w->antennaButtonClicked(nrig, object.value("antenna").toInt());
+      } },
+    { "togglescan", [](MainWindow *w, int nrig, quint64, const QJsonObject &) {
+        w->toggleAntennaScanning(nrig);
+      } },
+    { "togglescanenabled", [](MainWindow *w, int nrig, quint64, const QJsonObject &) {
+        w->toggleScanEnabled(nrig);
+      } },
+    { "toggletracking", [](MainWindow *w, int nrig, quint64, const QJsonObject &) {
+        w->toggleAntennaTracking(nrig);
+      } },
+    { "togglelock", [](MainWindow *w, int nrig, quint64, const QJsonObject &) {
+        w->toggleAntennaLock(nrig);
+      } },
+    { "changegroup", [](MainWindow *w, int nrig, quint64, const QJsonObject &object) {
+        w->cbGroupChanged(nrig, object.value("value").toString());
+      } },
+    { "changeband", [](MainWindow *w, int nrig, quint64, const QJsonObject &object) {
+        w->cbBandChanged(nrig, object.value("value").toString());
+      } },
+    { "changescandelay", [](MainWindow *w, int nrig, quint64, const QJsonObject &object) {
+        w->currentScanDelay[nrig] = object.value("value").toInt() * 100 + 100;
+        w->scanTimer[nrig].setInterval(w->currentScanDelay[nrig]);
+        if (w->scanTimer[nrig].isActive()) w->scanTimer[nrig].start(); // scanning, new delay now
+        w->cbScanDelaySetIndex(nrig);
+      } },
+    { "changelinked", [](MainWindow *w, int nrig, quint64, const QJsonObject &object) {
+        w->currentTrackedRadio[nrig] = object.value("value").toInt();
+        w->cbLinkedSetIndex(nrig);
+      } },
+    { "getEllipseData", [](MainWindow *w, int nrig, quint64 pSender, const QJsonObject &) {
+        w->updateGraphicsEllipse(nrig, pSender); // full to the asking client
+      } },
+    { "swapantennas", [](MainWindow *w, int nrig, quint64, const QJsonObject &) {
+        w->swapAntennas(nrig);
+      } },
+    { "resync", [](MainWindow *w, int nrig, quint64 pSender, const QJsonObject &) {
+        w->resyncClient(nrig, pSender);
+      } },
+  };
+  return handlers;
+}
 
-  int nrig = -1;
-  for (const auto &client : qAsConst(m_clients)) {
-    if (client.websocket == pSender) {
-      nrig = client.radio;
-      break;
+
+/*! register a client for a set of radios, or change the set of an already
+  registered one, and initialize its windows
+*/
+void MainWindow::subscribeClient(quint64 pSender, quint32 radios, bool tagged, bool cbor)
+{
+  auto client = m_clients.find(pSender);
+  if (client != m_clients.end()) {
+    //qDebug() << "client already registered, re-initializing";
+    logger->log(kLogServer, QString("re-initializing as radio %1")
+                               .arg(radioNumbers(radios)),
+                -1, clientPeers.value(pSender));
+  } else {
+    client = m_clients.insert(pSender, clientinfo(pSender));
+    //qDebug() << "new client registered as radio " << radioNumbers(radios);
+    statusBarUi->showMessage(QString("New client registered as radio %1")
+                                  .arg(radioNumbers(radios)),
+                                  tmpStatusMsgDelay);
+    logger->log(kLogServer, QString("registered as radio %1")
+                               .arg(radioNumbers(radios)),
+                -1, clientPeers.value(pSender));
+  }
+  quint32 previous = client->radios;
+  client->radios = radios;
+  client->tagged = tagged;
+  client->cbor = cbor;
+  client->radio = -1;
+  if (!tagged) {
+    for (int i=0; i<NRIG; ++i) {
+      if (radios & (1u << i)) client->radio = i;
     }
   }
 
-  if (nrig >= 0) {
-    //qDebug() << "processMessage radio: " << nrig+1;
-    serverLog->appendPlainText(QString("[%1][%2] %3:%4 %5")
-                                  .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                  .arg(nrig + 1)
-                                  .arg(pSender->peerAddress().toString())
-                                  .arg(pSender->peerPort())
-                                  .arg(QString::fromUtf8(message).simplified()));
-
-    if (object.value("action").toString() == "bearing") {
-      bearingChangedMouse(nrig, object.value("degrees").toInt());
-      //qDebug() << "bearing " << bearing;
-    } else if (object.value("action").toString() == "buttonclicked") {
-      antennaButtonClicked(nrig, object.value("antenna").toInt());
-    } else if (object.value("action").toString() == "togglescan") {
-      //qDebug() << "togglescan";
-      toggleAntennaScanning(nrig);
-    } else if (object.value("action").toString() == "togglescanenabled") {
-      toggleScanEnabled(nrig);
-    } else if (object.value("action").toString() == "toggletracking") {
-      //qDebug() << "toggletracking";
-      toggleAntennaTracking(nrig);
-    } else if (object.value("action").toString() == "togglelock") {
-      //qDebug() << "togglelock";
-      toggleAntennaLock(nrig);
-    } else if (object.value("action").toString() == "changegroup") {
-      cbGroupChanged(nrig, object.value("value").toString());
-      //qDebug() << "changegroup " << group;
-      // search group
-    } else if (object.value("action").toString() == "changeband") {
-      cbBandChanged(nrig, object.value("value").toString());
-      //qDebug() << "changeband " << band;
-    } else if (object.value("action").toString() == "changescandelay") {
-      currentScanDelay[nrig] = object.value("value").toInt() * 100 + 100;
-      cbScanDelaySetIndex(nrig);
-      //qDebug() << "changescandelay " << scanDelay;
-      // update global scna delay
-    } else if (object.value("action").toString() == "changelinked") {
-      currentTrackedRadio[nrig] = object.value("value").toInt();
-      cbLinkedSetIndex(nrig);
-      //qDebug() << "changelinked " << linked;
-    } else if (object.value("action").toString() == "getEllipseData") {
-      updateGraphicsEllipse(nrig);
-    } else if (object.value("action").toString() == "swapantennas") {
-      swapAntennas(nrig);
+  bool first = true;
+  for (int i=0; i<NRIG; ++i) {
+    quint32 bit = 1u << i;
+    if ((previous & bit) && !(radios & bit)) {
+      radioClients[i].removeOne(pSender);
+      radioClientsChanged(i);
+    } else if (radios & bit) {
+      if (!(previous & bit)) radioClients[i] << pSender;
+      // initialize client window
+      if (cbor && first) {
+        sendProtocolIds(i, pSender);
+      }
+      first = false;
+      sendSnapshot(i, pSender);
+      radioClientsChanged(i);
     }
   }
+}
+
+/*! update client count of radio, clear states when the last one left
+*/
+void MainWindow::radioClientsChanged(int nrig)
+{
+  int cnt = radioClients[nrig].size();
+  if (cnt > 0) {
+    clientsLabel[nrig]->setText(QString::number(cnt));
+  } else { // no other clients registered for radio, do some cleanup
+    setAntennaLock(nrig, false);
+    setAntennaScanning(nrig, false);
+    setAntennaTracking(nrig, false);
 
+    clientsLabel[nrig]->setText("");
+    //qDebug() << "No clients left for radio " << nrig+1 << ", cleared lock/scan/tracking states";
+    statusBarUi->showMessage(QString("No clients left for radio %1, cleared states")
+                                  .arg(nrig+1),
+                                  tmpStatusMsgDelay);
+  }
 }
 
+/*! "1, 3, 4" for log messages
+*/
+QString MainWindow::radioNumbers(quint32 radios)
+{
+  QStringList list;
+  for (int i=0; i<NRIG; ++i) {
+    if (radios & (1u << i)) list << QString::number(i + 1);
+  }
+  return list.join(", ");
+}
 
 void MainWindow::swapAntennas(int nrig)
 {
@@ -616,18 +674,15 @@ void MainWindow::swapAntennas(int nrig)
   QString tmpGroupLabel_2 = QStringLiteral("");
   int displayMode_1 = kDispNone;
   int displayMode_2 = kDispNone;
-  QSqlQuery query(db);
-  query.exec(QString("SELECT * from groups where id = %1")
-                .arg(currentGroup[nrig]));
-  if (query.first()) {
-    tmpGroupLabel_1 = query.value("label").toString();
-    displayMode_1 = query.value("display_mode").toInt();
+  const Topology::Group *grp = topology.group(currentGroup[nrig]);
+  if (grp) {
+    tmpGroupLabel_1 = grp->label;
+    displayMode_1 = grp->display_mode;
   }
-  query.exec(QString("SELECT * from groups where id = %1")
-                .arg(currentGroup[coChannel[nrig]]));
-  if (query.first()) {
-    tmpGroupLabel_2 = query.value("label").toString();
-    displayMode_2 = query.value("display_mode").toInt();
+  grp = topology.group(currentGroup[coChannel[nrig]]);
+  if (grp) {
+    tmpGroupLabel_2 = grp->label;
+    displayMode_2 = grp->display_mode;
   }
 
   setAntennaScanning(nrig, false);
@@ -716,22 +771,20 @@ void MainWindow::antennaChanged(int nrig)
   int cat_id = 0;
   int hpf = 0;
   int bpf = 0;
-  int gain = settings->value(s_radioGain[nrig], s_radioGain_def).toInt();
+  int gain = radioConfig[nrig].gain;
   int display_mode = getDisplayMode(currentGroup[nrig]);
   int display_mode_coChannel = getDisplayMode(currentGroup[coChannel[nrig]]);
 
-  QSqlQuery query(db);
-  query.exec(QString("SELECT * from bands where id = %1")
-                  .arg(currentBand[nrig]));
-  if (query.first()) {
-    cat_id = query.value("cat_id").toInt();
-    if (settings->value(s_radioBpf[nrig], s_radioBpf_def).toBool()) {
-      bpf = query.value("bpf").toInt();
+  const Topology::Band *band = topology.band(currentBand[nrig]);
+  if (band) {
+    cat_id = band->cat_id;
+    if (radioConfig[nrig].bpf) {
+      bpf = band->bpf;
     }
-    if (settings->value(s_radioHpf[nrig], s_radioHpf_def).toBool()) {
-      hpf = query.value("hpf").toInt();
+    if (radioConfig[nrig].hpf) {
+      hpf = band->hpf;
     }
-    gain += query.value("gain").toInt();
+    gain += band->gain;
   }
 
   QString data;
@@ -740,14 +793,13 @@ void MainWindow::antennaChanged(int nrig)
                       .arg(cat_id) ); // msg type, addressee, radio number,
                                       // band id, bearing (not needed)
 
-  query.exec(QString("SELECT * from antennas where id = %1")
-                .arg(currentAntenna[nrig]));
-  if (query.first()) {
-    radioAntennaLabel[nrig]->setText(query.value("label").toString());
-    gain += query.value("gain").toInt();
+  const Topology::Antenna *ant = topology.antenna(currentAntenna[nrig]);
+  if (ant) {
+    radioAntennaLabel[nrig]->setText(ant->label);
+    gain += ant->gain;
     data.append(QString("%1 %2 %3 %4 %5\r")
-                      .arg(query.value("switch_port").toInt())
-                      .arg(query.value("vant").toInt())
+                      .arg(ant->switch_port)
+                      .arg(ant->vant)
                       .arg(gain)
                       .arg(hpf)
                       .arg(bpf) );
@@ -758,6 +810,8 @@ void MainWindow::antennaChanged(int nrig)
   }
 
   rs485SendData(data.toUtf8());
+  journal.append(nrig, trackingState[nrig] ? kCauseTracking : switchCause, currentBand[nrig],
+                 currentGroup[nrig], currentAntenna[nrig], ant ? ant->switch_port : 0, currentBearing[nrig]);
 
   //if (currentGain[nrig] != gain) {
     currentGain[nrig] = gain;
@@ -787,15 +841,13 @@ void MainWindow::antennaChanged(int nrig)
   cbGroupAddItems(coChannel[nrig]); // update co-channel group box
 }
 
-void MainWindow::lbHpfSetText(int nrig, QWebSocket *pClient)
+void MainWindow::lbHpfSetText(int nrig, quint64 pClient)
 {
   int hpf = 0;
-  QSqlQuery query(db);
-  query.exec(QString("SELECT * from bands where id = %1")
-                .arg(currentBand[nrig]));
-  if (query.first()) {
-    if (settings->value(s_radioHpf[nrig], s_radioHpf_def).toBool()) {
-      hpf = query.value("hpf").toInt();
+  const Topology::Band *band = topology.band(currentBand[nrig]);
+  if (band) {
+    if (radioConfig[nrig].hpf) {
+      hpf = band->hpf;
     }
   }
   QJsonObject object;
@@ -806,15 +858,13 @@ void MainWindow::lbHpfSetText(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::lbBpfSetText(int nrig, QWebSocket *pClient)
+void MainWindow::lbBpfSetText(int nrig, quint64 pClient)
 {
   int bpf = 0;
-  QSqlQuery query(db);
-  query.exec(QString("SELECT * from bands where id = %1")
-                  .arg(currentBand[nrig]));
-  if (query.first()) {
-    if (settings->value(s_radioBpf[nrig], s_radioBpf_def).toBool()) {
-      bpf = query.value("bpf").toInt();
+  const Topology::Band *band = topology.band(currentBand[nrig]);
+  if (band) {
+    if (radioConfig[nrig].bpf) {
+      bpf = band->bpf;
     }
   }
   QJsonObject object;
@@ -825,7 +875,7 @@ void MainWindow::lbBpfSetText(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::lbGainSetText(int nrig, QWebSocket *pClient)
+void MainWindow::lbGainSetText(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("gainLabel"));
@@ -841,18 +891,16 @@ void MainWindow::lbGainSetText(int nrig, QWebSocket *pClient)
 int MainWindow::getAux(int nrig)
 {
   int aux = 0;
-  if (settings->value(s_radioAux[nrig], s_radioAux_def).toBool()) {
-    QSqlQuery query(db);
-    query.exec(QString("select aux from bands where id = %1")
-                  .arg(currentBand[nrig]));
-    if (query.first()) {
-      aux = query.value("aux").toInt();
+  if (radioConfig[nrig].aux) {
+    const Topology::Band *band = topology.band(currentBand[nrig]);
+    if (band) {
+      aux = band->aux;
     }
   }
   return aux;
 }
 
-void MainWindow::lbAuxSetText(int nrig, QWebSocket *pClient)
+void MainWindow::lbAuxSetText(int nrig, quint64 pClient)
 {
   int aux = getAux(nrig);
   QJsonObject object;
@@ -885,11 +933,9 @@ void MainWindow::toggleAntennaTracking(int nrig)
       currentGroup[nrig] = prevGroupTrack[nrig];
       QString label = prevGroupLabel[nrig];
       int display_mode = getDisplayMode(currentGroup[nrig]);
-      QSqlQuery query(db);
-      query.exec(QString("select * from groups where id = %1")
-                    .arg(currentGroup[nrig]));
-      if (query.first()) {
-        label = query.value("label").toString(); // in case name changed
+      const Topology::Group *grp = topology.group(currentGroup[nrig]);
+      if (grp) {
+        label = grp->label; // in case name changed
       }
       radioGroupLabel[nrig]->setText(label);
       cbGroupSetText(nrig, label);
@@ -937,35 +983,24 @@ void MainWindow::setAntennaTracking(int nrig, bool state)
       // choose group or abort
       // set antenna based on tracked radio's bearing
       // add tracking code to antennaChanged so tracked radio updates tracker
-      QSqlQuery query(db);
-      QString sql,match,sort;
-      if (nrig < 4) {
-        match.append(" and groups.radios1_4 = 1");
-      } else {
-        match.append(" and groups.radios5_8 = 1");
-      }
-      match.append(QString(" and groups.display_mode = 1 and groups.id <> %1")
-                          .arg(currentGroup[currentTrackedRadio[nrig]]) );
-      sort.append(" order by groups.priority desc, groups.id desc");
-      sql.append(kSelectGroupSQL.arg(currentBand[nrig])
-                                .arg(match)
-                                .arg(sort)
-                                .arg("") );
-
-      //qDebug() << sql;
-      query.exec(sql);
-      bool found = false;
-      while (!found && query.next()) {
-        if (currentGroup[nrig] == query.value("id").toInt()) {
-          found = true; // keep current group if usable for tracking
+      const Topology::Group *grp = nullptr;
+      const Topology::Group *first = nullptr;
+      for (int id : topology.groupsForBand(currentBand[nrig], nrig)) {
+        const Topology::Group *g = topology.group(id);
+        if (g->display_mode != kDispCompass ||
+            g->id == currentGroup[currentTrackedRadio[nrig]]) {
+          continue;
         }
-      }
-      if (!found) {
-        query.seek(QSql::BeforeFirstRow);
-        if (query.next()) { // use highest priority group
-          found = true;
+        if (!first) first = g;
+        if (currentGroup[nrig] == g->id) {
+          grp = g; // keep current group if usable for tracking
+          break;
         }
       }
+      if (!grp) {
+        grp = first; // use highest priority group
+      }
+      bool found = (grp != nullptr);
       if (found) {
         // found a group, how to verify no collisions?
         setAntennaScanning(nrig, false);
@@ -981,11 +1016,11 @@ void MainWindow::setAntennaTracking(int nrig, bool state)
         //qDebug() << "Prev: " << prevGroup[nrig] << " Current: " << currentGroup[nrig];
         //prevAntenna[nrig] = currentAntenna[nrig];
         //prevGroup[nrig] = currentGroup[nrig];
-        if (currentGroup[nrig] != query.value("id").toInt()) {
-          currentGroup[nrig] = query.value("id").toInt();
+        if (currentGroup[nrig] != grp->id) {
+          currentGroup[nrig] = grp->id;
           //currentAntenna[nrig] = 0; // force antenna update
-          radioGroupLabel[nrig]->setText(query.value("label").toString());
-          cbGroupSetText(nrig, query.value("label").toString());
+          radioGroupLabel[nrig]->setText(grp->label);
+          cbGroupSetText(nrig, grp->label);
           groupChanged(nrig);
         } else { // group didn't change
           selectAntenna(nrig);
@@ -1031,75 +1066,54 @@ bool MainWindow::selectAntenna(int nrig, bool makeChanges, int newGroup)
 
   int display_mode = getDisplayMode(group); // list mode
   int coChannelPort = getSwitchPort(currentAntenna[ coChannel[nrig] ]); // antenna switch port of co-channel radio
-  QSqlQuery query(db);
-  QString sql, match, sort;
-  if (nrig < 4) {
-    match.append(" and antennas.radios1_4 = 1");
-  } else {
-    match.append(" and antennas.radios5_8 = 1");
-  }
-  if (display_mode == kDispCompass) {
-    sort.append(" order by antennas.start_deg asc");
-  } else {
-    sort.append(" order by antennas.priority desc, antennas.id asc");
-  }
-  sql.append(kSelectAntennaSQL.arg(group)
-                              .arg(match)
-                              .arg(sort) );
+  const QVector<int> &antennas = (display_mode == kDispCompass) ?
+                                  topology.antennasByBearing(group, nrig) :
+                                  topology.antennasByPriority(group, nrig);
 
-  //qDebug() << sql;
   bool found = false;
-  query.exec(sql);
-
-  while (!found && (!trackingState[nrig] || !makeChanges) && query.next()) { // skip if in tracking mode
-    if (query.value("switch_port").toInt() != coChannelPort) {
-      if (query.value("id").toInt() == currentAntenna[nrig]) { // keep current antenna
-        found = true;
+  if (!trackingState[nrig] || !makeChanges) { // skip if in tracking mode
+    for (int id : antennas) {
+      if (topology.switchPort(id) != coChannelPort) {
+        if (id == currentAntenna[nrig]) { // keep current antenna
+          found = true;
+          break;
+        }
       }
     }
   }
 
-  query.seek(QSql::BeforeFirstRow);
   // search here for antenna that covers current bearing
-  if (currentBearing[nrig] >= 0) { // && display_mode == kDispCompass) {
-    while (!found && query.next()) {
-      if (query.value("switch_port").toInt() != coChannelPort) {
-        if (currentBearing[nrig] >= query.value("start_deg").toInt() &&
-            currentBearing[nrig] <= query.value("stop_deg").toInt() ) {
-          found = true;
-        } else if (query.value("stop_deg").toInt() < query.value("start_deg").toInt()) {
-          if (currentBearing[nrig] >= query.value("start_deg").toInt() &&
-              currentBearing[nrig] <= query.value("stop_deg").toInt() + 360) {
-            found = true;
-          } else if (currentBearing[nrig] >= query.value("start_deg").toInt() - 360 &&
-                     currentBearing[nrig] <= query.value("stop_deg").toInt()) {
-            found = true;
-          }
-        }
-        if (found && makeChanges) {
+  if (!found && currentBearing[nrig] >= 0) { // && display_mode == kDispCompass) {
+    for (int id : topology.bearingCandidates(group, nrig, currentBearing[nrig], display_mode)) {
+      if (topology.switchPort(id) != coChannelPort) {
+        found = true;
+        if (makeChanges) {
           //qDebug() << "found new antenna covering current bearing";
-          if (currentAntenna[nrig] != query.value("id").toInt()) {
-            currentAntenna[nrig] = query.value("id").toInt();
+          if (currentAntenna[nrig] != id) {
+            currentAntenna[nrig] = id;
             antennaChanged(nrig);
           }
         }
+        break;
       }
     }
   }
 
-  query.seek(QSql::BeforeFirstRow);
-  while (!found && (!trackingState[nrig] || !makeChanges) && query.next()) {
-    if (query.value("switch_port").toInt() != coChannelPort) {
-      //qDebug() << "found new antenna via priority search";
-      found = true;
-      if (makeChanges) {
-        currentAntenna[nrig] = query.value("id").toInt();
-        int bearing = calcCenterBearing(query.value("start_deg").toInt(), query.value("stop_deg").toInt());
-        if (currentBearing[nrig] != bearing) {
-          currentBearing[nrig] = bearing;
-          bearingChanged(nrig);
+  if (!trackingState[nrig] || !makeChanges) {
+    for (int i = 0; !found && i < antennas.size(); ++i) {
+      const Topology::Antenna *ant = topology.antenna(antennas.at(i));
+      if (ant->switch_port != coChannelPort) {
+        //qDebug() << "found new antenna via priority search";
+        found = true;
+        if (makeChanges) {
+          currentAntenna[nrig] = ant->id;
+          int bearing = calcCenterBearing(ant->start_deg, ant->stop_deg);
+          if (currentBearing[nrig] != bearing) {
+            currentBearing[nrig] = bearing;
+            bearingChanged(nrig);
+          }
+          antennaChanged(nrig);
         }
-        antennaChanged(nrig);
       }
     }
   }
@@ -1218,6 +1232,41 @@ void MainWindow::bearingChanged(int nrig)
   }
 }
 
+/*! bearing from a client, a drag sends a stream of them. only the
+  latest is applied, at most once per bearingInterval ms, the last one
+  always
+*/
+void MainWindow::queueBearing(int nrig, int bearing)
+{
+  pendingBearing[nrig] = bearing;
+  if (bearingTimer[nrig].isActive()) return;
+  int wait = 0;
+  if (bearingApplied[nrig].isValid()) {
+    wait = qMax(bearingInterval - int(bearingApplied[nrig].elapsed()), 0);
+  }
+  bearingTimer[nrig].start(wait);
+}
+
+void MainWindow::applyPendingBearing(int nrig)
+{
+  bearingTimer[nrig].stop();
+  if (pendingBearing[nrig] < 0) return;
+  int bearing = pendingBearing[nrig];
+  pendingBearing[nrig] = -1;
+  bearingApplied[nrig].start();
+  int cause = switchCause;
+  switchCause = kCauseClient;
+  bearingChangedMouse(nrig, bearing);
+  switchCause = cause;
+}
+
+void MainWindow::applyPendingBearings()
+{
+  for (int i=0; i<NRIG; ++i) {
+    applyPendingBearing(i);
+  }
+}
+
 void MainWindow::bearingChangedMouse(int nrig, int bearing)
 {
   setAntennaScanning(nrig, false);
@@ -1233,40 +1282,16 @@ void MainWindow::bearingChangedMouse(int nrig, int bearing)
 
   int coChannelPort = getSwitchPort(currentAntenna[ coChannel[nrig] ]); // antenna switch port of co-channel radio
 
-  QSqlQuery query(db);
-  QString sql,match,sort;
-  if (nrig < 4) {
-    match.append(" and antennas.radios1_4 = 1");
-  } else {
-    match.append(" and antennas.radios5_8 = 1");
-  }
-  sort.append(" order by antennas.start_deg asc");
-  sql.append(kSelectAntennaSQL.arg(currentGroup[nrig])
-                              .arg(match)
-                              .arg(sort) );
-
-  //qDebug() << sql;
-  bool found = false;
-  query.exec(sql);
-  while (!found && query.next()) {
-    if (query.value("switch_port").toInt() != coChannelPort) {
-      if (bearing >= query.value("start_deg").toInt() &&
-          bearing <= query.value("stop_deg").toInt() ) {
-        found = true;
-      } else if (query.value("stop_deg").toInt() < query.value("start_deg").toInt()) {
-        if (bearing >= query.value("start_deg").toInt() &&
-            bearing <= query.value("stop_deg").toInt() + 360) {
-          found = true;
-        } else if (bearing >= query.value("start_deg").toInt() - 360 &&
-                   bearing <= query.value("stop_deg").toInt()) {
-          found = true;
-        }
-      }
+  int antenna = 0;
+  for (int id : topology.bearingCandidates(currentGroup[nrig], nrig, bearing)) {
+    if (topology.switchPort(id) != coChannelPort) {
+      antenna = id;
+      break;
     }
   }
-  if (found) {
-    if (currentAntenna[nrig] != query.value("id").toInt()) {
-      currentAntenna[nrig] = query.value("id").toInt();
+  if (antenna) {
+    if (currentAntenna[nrig] != antenna) {
+      currentAntenna[nrig] = antenna;
       antennaChanged(nrig);
     }
   } // no bearing match, keep current antenna
@@ -1274,37 +1299,24 @@ void MainWindow::bearingChangedMouse(int nrig, int bearing)
 }
 
 
-void MainWindow::updateGraphicsLabels(int nrig, QWebSocket *pClient)
+void MainWindow::updateGraphicsLabels(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("GraphicsLabels"));
   object.insert("method", QJsonValue::fromVariant("update"));
   QJsonArray labels;
   //qDebug() << "updateGraphicsLabels start";
-  QSqlQuery query(db);
   int coChannelPort = getSwitchPort(currentAntenna[ coChannel[nrig] ]); // antenna switch port of co-channel radio
-  QString sql,match,sort;
-  if (nrig < 4) {
-    match.append(" and antennas.radios1_4 = 1");
-  } else {
-    match.append(" and antennas.radios5_8 = 1");
-  }
-  sort.append(" order by antennas.start_deg asc");
-  sql.append(kSelectAntennaSQL.arg(currentGroup[nrig])
-                              .arg(match)
-                              .arg(sort) );
-
-  //qDebug() << sql;
-  query.exec(sql);
   int angle;
-  while (query.next()) {
+  for (int id : topology.antennasByBearing(currentGroup[nrig], nrig)) {
+    const Topology::Antenna *ant = topology.antenna(id);
     QJsonObject attributes;
-    angle = calcCenterBearing(query.value("start_deg").toInt(), query.value("stop_deg").toInt());
+    angle = calcCenterBearing(ant->start_deg, ant->stop_deg);
     attributes.insert("angle", QJsonValue::fromVariant(angle));
-    attributes.insert("text", QJsonValue::fromVariant(query.value("label").toString()));
-    if (currentAntenna[nrig] == query.value("id").toInt()) {
+    attributes.insert("text", QJsonValue::fromVariant(ant->label));
+    if (currentAntenna[nrig] == ant->id) {
       attributes.insert("state", QJsonValue::fromVariant(kSelected));
-    } else if (query.value("switch_port").toInt() == coChannelPort) {
+    } else if (ant->switch_port == coChannelPort) {
       attributes.insert("state", QJsonValue::fromVariant(kUnavailable));
     } else {
       attributes.insert("state", QJsonValue::fromVariant(kAvailable));
@@ -1316,37 +1328,24 @@ void MainWindow::updateGraphicsLabels(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::updateGraphicsLines(int nrig, QWebSocket *pClient)
+void MainWindow::updateGraphicsLines(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("GraphicsLines"));
   object.insert("method", QJsonValue::fromVariant("update"));
   QJsonArray angles;
   //qDebug() << "updateGraphicsLines start";
-  QSqlQuery query(db);
-  QString sql,match,sort;
-  if (nrig < 4) {
-    match.append(" and antennas.radios1_4 = 1");
-  } else {
-    match.append(" and antennas.radios5_8 = 1");
-  }
-  sort.append(" order by antennas.start_deg asc");
-  sql.append(kSelectAntennaSQL.arg(currentGroup[nrig])
-                              .arg(match)
-                              .arg(sort) );
-
-  //qDebug() << sql;
-  query.exec(sql);
-  while (query.next()) {
-    angles.push_back(QJsonValue::fromVariant(query.value("start_deg").toInt()));
-    angles.push_back(QJsonValue::fromVariant(query.value("stop_deg").toInt()));
+  for (int id : topology.antennasByBearing(currentGroup[nrig], nrig)) {
+    const Topology::Antenna *ant = topology.antenna(id);
+    angles.push_back(QJsonValue::fromVariant(ant->start_deg));
+    angles.push_back(QJsonValue::fromVariant(ant->stop_deg));
   }
   //qDebug() << "updateGraphicsLines end";
   object.insert("angles", QJsonValue(angles));
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::updateGraphicsEllipse(int nrig, QWebSocket *pClient)
+void MainWindow::updateGraphicsEllipse(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("GraphicsEllipse"));
@@ -1355,29 +1354,17 @@ void MainWindow::updateGraphicsEllipse(int nrig, QWebSocket *pClient)
 
   int coChannelPort = getSwitchPort(currentAntenna[ coChannel[nrig] ]); // antenna switch port of co-channel radio
 
-  QSqlQuery query(db);
-  QString sql,match,sort;
-  if (nrig < 4) {
-    match.append(" and antennas.radios1_4 = 1");
-  } else {
-    match.append(" and antennas.radios5_8 = 1");
-  }
-  sort.append(" order by antennas.start_deg asc");
-  sql.append(kSelectAntennaSQL.arg(currentGroup[nrig])
-                              .arg(match)
-                              .arg(sort) );
-
-  query.exec(sql);
-  while (query.next()) {
+  for (int id : topology.antennasByBearing(currentGroup[nrig], nrig)) {
+    const Topology::Antenna *ant = topology.antenna(id);
     QJsonObject attributes;
-    if (currentAntenna[nrig] == query.value("id").toInt()) {
-      attributes.insert("start_deg", QJsonValue::fromVariant(query.value("start_deg").toInt()));
-      attributes.insert("stop_deg", QJsonValue::fromVariant(query.value("stop_deg").toInt()));
+    if (currentAntenna[nrig] == ant->id) {
+      attributes.insert("start_deg", QJsonValue::fromVariant(ant->start_deg));
+      attributes.insert("stop_deg", QJsonValue::fromVariant(ant->stop_deg));
       attributes.insert("state", QJsonValue::fromVariant(kSelected));
       ellipses.push_back(attributes);
-    } else if (query.value("switch_port").toInt() == coChannelPort) {
-      attributes.insert("start_deg", QJsonValue::fromVariant(query.value("start_deg").toInt()));
-      attributes.insert("stop_deg", QJsonValue::fromVariant(query.value("stop_deg").toInt()));
+    } else if (ant->switch_port == coChannelPort) {
+      attributes.insert("start_deg", QJsonValue::fromVariant(ant->start_deg));
+      attributes.insert("stop_deg", QJsonValue::fromVariant(ant->stop_deg));
       attributes.insert("state", QJsonValue::fromVariant(kUnavailable));
       ellipses.push_back(attributes);
     }
@@ -1388,7 +1375,7 @@ void MainWindow::updateGraphicsEllipse(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::setLayoutIndex(int nrig, int idx, QWebSocket *pClient)
+void MainWindow::setLayoutIndex(int nrig, int idx, quint64 pClient)
 {
   /**
    * kDispList=0
@@ -1402,7 +1389,7 @@ void MainWindow::setLayoutIndex(int nrig, int idx, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::updateAntennaButtonsSelection(int nrig, QWebSocket *pClient)
+void MainWindow::updateAntennaButtonsSelection(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("AntennaButtons"));
@@ -1411,26 +1398,13 @@ void MainWindow::updateAntennaButtonsSelection(int nrig, QWebSocket *pClient)
 
   int coChannelPort = getSwitchPort(currentAntenna[ coChannel[nrig] ]); // antenna switch port of co-channel radio
 
-  QSqlQuery query(db);
-  QString sql,match,sort;
-  // radio range
-  if (nrig < 4) {
-    match.append(" and antennas.radios1_4 = 1");
-  } else {
-    match.append(" and antennas.radios5_8 = 1");
-  }
-  sort.append(" order by antennas.start_deg asc");
-  sql.append(kSelectAntennaSQL.arg(currentGroup[nrig])
-                              .arg(match)
-                              .arg(sort) );
-
-  query.exec(sql);
-  while (query.next()) {
+  for (int id : topology.antennasByBearing(currentGroup[nrig], nrig)) {
+    const Topology::Antenna *ant = topology.antenna(id);
     QJsonObject attributes;
-    attributes.insert("antenna", QJsonValue::fromVariant(query.value("id").toInt()));
-    if (currentAntenna[nrig] == query.value("id").toInt()) {
+    attributes.insert("antenna", QJsonValue::fromVariant(ant->id));
+    if (currentAntenna[nrig] == ant->id) {
       attributes.insert("state", QJsonValue::fromVariant(kSelected));
-    } else if (query.value("switch_port").toInt() == coChannelPort) {
+    } else if (ant->switch_port == coChannelPort) {
       attributes.insert("state", QJsonValue::fromVariant(kUnavailable));
     } else {
       attributes.insert("state", QJsonValue::fromVariant(kAvailable));
@@ -1442,7 +1416,7 @@ void MainWindow::updateAntennaButtonsSelection(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::createAntennaButtons(int nrig, QWebSocket *pClient)
+void MainWindow::createAntennaButtons(int nrig, quint64 pClient)
 {
   //qDebug() << "buttons";
 
@@ -1454,32 +1428,22 @@ void MainWindow::createAntennaButtons(int nrig, QWebSocket *pClient)
     object.insert("object", QJsonValue::fromVariant("AntennaButtons"));
     object.insert("method", QJsonValue::fromVariant("create"));
     QJsonArray buttons;
-    QSqlQuery query(db);
-    QString sql,match,sort;
-    if (nrig < 4) {
-      match.append(" and antennas.radios1_4 = 1");
-    } else {
-      match.append(" and antennas.radios5_8 = 1");
-    }
-    if (display_mode == kDispCompass) {
-      sort.append(" order by antennas.start_deg asc");
-    } else {
-      sort.append(" order by antennas.priority desc, antennas.id asc");
-    }
-    sql.append(kSelectAntennaSQL.arg(currentGroup[nrig])
-                                .arg(match)
-                                .arg(sort) );
-
-    //qDebug() << sql;
-    query.exec(sql);
-    while (query.next()) {
+    const QVector<int> &antennas = (display_mode == kDispCompass) ?
+                                    topology.antennasByBearing(currentGroup[nrig], nrig) :
+                                    topology.antennasByPriority(currentGroup[nrig], nrig);
+    for (int id : antennas) {
+      const Topology::Antenna *ant = topology.antenna(id);
       QJsonObject attributes;
-      attributes.insert("label", QJsonValue::fromVariant(query.value("label").toString()));
-      attributes.insert("antenna", QJsonValue::fromVariant(query.value("id").toInt()));
+      attributes.insert("label", QJsonValue::fromVariant(ant->label));
+      attributes.insert("antenna", QJsonValue::fromVariant(ant->id));
       buttons.push_back(attributes);
     }
 
     object.insert("buttons", QJsonValue::fromVariant(buttons));
+    if (pClient == 0) {
+      // new button set, next selection update goes out in full
+      radioDelta[nrig][kDeltaButtons].list = QJsonArray();
+    }
     sendRadioWindowData(nrig, object, pClient);
   }
 }
@@ -1497,11 +1461,9 @@ void MainWindow::antennaButtonClicked(int nrig, int antenna)
     if (currentAntenna[nrig] != antenna) {
       currentAntenna[nrig] = antenna;
       int bearing = 0;
-      QSqlQuery query(db);
-      query.exec(QString("SELECT start_deg,stop_deg from antennas where id = %1")
-                      .arg(antenna) );
-      if (query.first()) {
-        bearing = calcCenterBearing(query.value("start_deg").toInt(), query.value("stop_deg").toInt());
+      const Topology::Antenna *ant = topology.antenna(antenna);
+      if (ant) {
+        bearing = calcCenterBearing(ant->start_deg, ant->stop_deg);
       }
       if (currentBearing[nrig] != bearing) {
         currentBearing[nrig] = bearing;
@@ -1515,146 +1477,182 @@ void MainWindow::antennaButtonClicked(int nrig, int antenna)
 
 
 
-void MainWindow::timeoutMainTimer()
+/*! apply CAT state to all radios
+
+  called on CAT events and settings changes. repeated until nothing
+  changes so sub-RX radios follow their main radio regardless of numbering
+*/
+void MainWindow::updateRadioStates()
 {
-  for (int i=0;i<NRIG;++i) {
+  int cause = switchCause;
+  switchCause = kCauseCat;
+  for (int pass=0;pass<NRIG;++pass) {
+    bool changed = false;
+    for (int i=0;i<NRIG;++i) {
+      if (updateRadioState(i)) changed = true;
+    }
+    if (!changed) break;
+  }
+  switchCause = cause;
+}
 
-    if (settings->value(s_radioEnable[i], s_radioEnable_def).toBool()) {
-      int freq = 0;
-      int ptt = 0;
-      int mainRx = 0;
-      bool catOpen = false;
-
-      if (settings->value(s_radioBandDecoder[i], s_radioBandDecoder_def).toInt() == kCat) {
-        freq = cat[i]->getRigFreq();
-        ptt = cat[i]->getRigPtt();
-        catOpen = cat[i]->radioOpen();
-        if (radioConnected[i] != catOpen) { // CAT state changed
-          //qDebug() << "timeoutMainTimer: cat connection changed " << i;
-          radioConnected[i] = catOpen;
-          radioConnectionStatus(i, radioConnected[i]);
-        }
+/*! update connection, ptt, frequency and band of one radio from the last
+  CAT state, returns true if anything changed
+*/
+bool MainWindow::updateRadioState(int i)
+{
+  bool changed = false;
+
+  if (radioConfig[i].enable) {
+    int freq = 0;
+    int ptt = 0;
+    int mainRx = 0;
+    bool open = false;
+
+    if (radioConfig[i].bandDecoder == kCat) {
+      freq = catState[i].freq;
+      ptt = catState[i].ptt;
+      open = catState[i].ok;
+      if (radioConnected[i] != open) { // CAT state changed
+        //qDebug() << "updateRadioState: cat connection changed " << i;
+        radioConnected[i] = open;
+        radioConnectionStatus(i, radioConnected[i]);
+        changed = true;
       }
-      if (settings->value(s_radioBandDecoder[i], s_radioBandDecoder_def).toInt() == kManual) {
-        if (!radioConnected[i]) {
-          radioConnected[i] = true;
-          radioConnectionStatus(i, radioConnected[i]);
-        }
+    }
+    if (radioConfig[i].bandDecoder == kManual) {
+      if (!radioConnected[i]) {
+        radioConnected[i] = true;
+        radioConnectionStatus(i, radioConnected[i]);
+        changed = true;
       }
+    }
 
-      bool ptt_tmp;
-      switch (settings->value(s_radioBandDecoder[i], s_radioBandDecoder_def).toInt()) {
-        case kSubRx:
-          mainRx = settings->value(s_radioSubRxNr[i], s_radioSubRxNr_def).toInt();
-          ptt_tmp = currentPtt[mainRx];
-          break;
-        case kCat:
-          ptt_tmp = ptt;
-          break;
-        case kManual:
-        default:
-          ptt_tmp = 0;
-          break;
+    bool ptt_tmp;
+    switch (radioConfig[i].bandDecoder) {
+      case kSubRx:
+        mainRx = radioConfig[i].subRxNr;
+        ptt_tmp = currentPtt[mainRx];
+        break;
+      case kCat:
+        ptt_tmp = ptt;
+        break;
+      case kManual:
+      default:
+        ptt_tmp = 0;
+        break;
+    }
+    if (currentPtt[i] != ptt_tmp) { // ptt state changed
+      //qDebug() << "updateRadioState: ptt state changed " << i;
+      currentPtt[i] = ptt_tmp;
+      lbPttState(i);
+      if (currentPtt[i]) {
+        radioPttLabel[i]->setText("TX");
+        radioPttLabel[i]->setStyleSheet("QLabel { color : red; font-weight:600; }");
+      } else {
+        radioPttLabel[i]->setText("RX");
+        radioPttLabel[i]->setStyleSheet("QLabel { color : green; font-weight:600; }");
       }
-      if (currentPtt[i] != ptt_tmp) { // ptt state changed
-        //qDebug() << "timeoutMainTimer: ptt state changed " << i;
-        currentPtt[i] = ptt_tmp;
-        lbPttState(i);
-        if (currentPtt[i]) {
-          radioPttLabel[i]->setText("TX");
-          radioPttLabel[i]->setStyleSheet("QLabel { color : red; font-weight:600; }");
-        } else {
-          radioPttLabel[i]->setText("RX");
-          radioPttLabel[i]->setStyleSheet("QLabel { color : green; font-weight:600; }");
-        }
+      changed = true;
+    }
+    if (scanPaused[i] && (!currentPtt[i] || !radioConfig[i].pauseScan)) {
+      // scan step held back during TX
+      scanPaused[i] = false;
+      if (scanState[i]) {
+        antennaStep(i, kNext, true);
+        scanTimer[i].start(currentScanDelay[i]);
       }
+    }
 
 
-      if (settings->value(s_radioBandDecoder[i], s_radioBandDecoder_def).toInt() == kCat) {
-        if (currentFreq[i] != freq) { // freq changed
-          int iFreqKhz = freq / 1000;
-          float fFreqKhz = freq / 1000.0;
-          if (freq) {
-            radioFreqLabel[i]->setText(QString::number(fFreqKhz, 'f', 2));
-          } else {
-            radioFreqLabel[i]->setText("");
-          }
-          QSqlQuery query(db);
-          query.exec("SELECT * from bands ORDER BY start_freq");
-          bool found = false;
-          while (!found && query.next()) {
-            if ( iFreqKhz >= query.value("start_freq").toInt() && iFreqKhz <= query.value("stop_freq").toInt()) {
-              found = true;
-              if (currentBand[i] != query.value("id").toInt()) { // band changed
-                radioBandLabel[i]->setText(query.value("name").toString());
-                cbBandSetText(i, query.value("name").toString());
-                currentBand[i] = query.value("id").toInt();
-                //qDebug() << "timeoutMainTimer: cat band change found";
-                bandChanged(i);
-                //break;
-              }
-            }
-          }
-          if (!found) { // no matching band definition
-            if (currentBand[i] != 0) {
-              currentBand[i] = 0;
-              radioBandLabel[i]->setText("");
-              cbBandSetText(i, QStringLiteral(""));
-              //qDebug() << "timeoutMainTimer: cat band change not found";
-              bandChanged(i);
-            }
-          }
-          currentFreq[i] = freq;
+    if (radioConfig[i].bandDecoder == kCat) {
+      if (currentFreq[i] != freq) { // freq changed
+        int iFreqKhz = freq / 1000;
+        float fFreqKhz = freq / 1000.0;
+        if (freq) {
+          radioFreqLabel[i]->setText(QString::number(fFreqKhz, 'f', 2));
+        } else {
+          radioFreqLabel[i]->setText("");
         }
-      }
-
-      if (settings->value(s_radioBandDecoder[i], s_radioBandDecoder_def).toInt() == kSubRx) {
-        catOpen = radioConnected[settings->value(s_radioSubRxNr[i], s_radioSubRxNr_def).toInt()];
-        if (radioConnected[i] != catOpen) {
-          radioConnected[i] = catOpen;
-          radioConnectionStatus(i, radioConnected[i]);
+        // no search while the radio stays inside its last band (or gap)
+        const Topology::Band *band = topology.band(topology.bandAtFreq(iFreqKhz, &bandHint[i]));
+        bool found = false;
+        if (band) {
+          found = true;
+          if (currentBand[i] != band->id) { // band changed
+            radioBandLabel[i]->setText(band->name);
+            cbBandSetText(i, band->name);
+            currentBand[i] = band->id;
+            //qDebug() << "updateRadioState: cat band change found";
+            bandChanged(i);
+          }
         }
-        if (currentBand[i] != currentBand[mainRx]) {
-          currentBand[i] = currentBand[mainRx];
-          radioBandLabel[i]->setText(radioBandLabel[mainRx]->text());
-          cbBandSetText(i, radioBandLabel[mainRx]->text());
-          //qDebug() << "timeoutMainTimer: subrx band change";
-          bandChanged(i);
+        if (!found) { // no matching band definition
+          if (currentBand[i] != 0) {
+            currentBand[i] = 0;
+            radioBandLabel[i]->setText("");
+            cbBandSetText(i, QStringLiteral(""));
+            //qDebug() << "updateRadioState: cat band change not found";
+            bandChanged(i);
+          }
         }
+        currentFreq[i] = freq;
+        changed = true;
       }
     }
 
-    // scanning
-    if (scanState[i]) {
-      if (scanCount[i] >= currentScanDelay[i] / timerPeriod) {
-        if (!settings->value(s_radioPauseScan[i], s_radioPauseScan_def).toBool() || !currentPtt[i]) {
-          antennaStep(i, kNext, true);
-          scanCount[i] = 0;
-        }
-      } else {
-        scanCount[i]++;
+    if (radioConfig[i].bandDecoder == kSubRx) {
+      open = radioConnected[radioConfig[i].subRxNr];
+      if (radioConnected[i] != open) {
+        radioConnected[i] = open;
+        radioConnectionStatus(i, radioConnected[i]);
+        changed = true;
+      }
+      if (currentBand[i] != currentBand[mainRx]) {
+        currentBand[i] = currentBand[mainRx];
+        radioBandLabel[i]->setText(radioBandLabel[mainRx]->text());
+        cbBandSetText(i, radioBandLabel[mainRx]->text());
+        //qDebug() << "updateRadioState: subrx band change";
+        bandChanged(i);
+        changed = true;
       }
     }
+  }
 
-  } // end nrig loop
-
+  return changed;
+}
 
+/*! next scan step, held back while transmitting if scan pauses on PTT
+*/
+void MainWindow::timeoutScanTimer(int nrig)
+{
+  if (!scanState[nrig]) {
+    scanTimer[nrig].stop();
+    return;
+  }
+  if (radioConfig[nrig].pauseScan && currentPtt[nrig]) {
+    scanPaused[nrig] = true; // resumed in updateRadioState
+    scanTimer[nrig].stop();
+    return;
+  }
+  int cause = switchCause;
+  switchCause = kCauseScan;
+  antennaStep(nrig, kNext, true);
+  switchCause = cause;
 }
 
 
 
 
 
-void MainWindow::rs485RcvdData ()
+void MainWindow::rs485RcvdData (const QString &text)
 {
-  if (rs485Serial->isOpen()) {
-    while(rs485Serial->canReadLine()) {
-      QString text = QString::fromUtf8(rs485Serial->readLine());
-      rs485RcvdDataLabel->setText(": " + text);
-    }
-  }
+  rs485RcvdDataLabel->setText(": " + text);
 }
 
+/*! queue a command for the RS485 I/O thread, returns at once. sent commands
+  show up in rs485Sent, failures in rs485SendFailed
+*/
 void MainWindow::rs485SendData (QByteArray data)
 {
 
@@ -1662,17 +1660,26 @@ void MainWindow::rs485SendData (QByteArray data)
   //rs485RcvdDataLabel->setText(QString::fromUtf8(data));
   //return;
 
-  if (rs485Serial->isOpen()) {
-    if(rs485Serial->write(data)) {
-      rs485RcvdDataLabel->setText(QString::fromUtf8(data));
-      serialLog->appendPlainText("[" + QDateTime::currentDateTime().toString("hh:mm:ss")
-                                 + "] " + QString::fromUtf8(data).simplified());
-    } else {
-      statusBarUi->showMessage("RS485 send error", tmpStatusMsgDelay);
-    }
+  // closed: nothing to do, as without a port
+  if (rs485IO->send(data) == Rs485IO::QueueFull) {
+    QString text = QString("RS485 send queue full, %1 commands dropped")
+                     .arg(rs485IO->droppedCommands());
+    statusBarUi->showMessage(text, tmpStatusMsgDelay);
+    logger->log(kLogSerial, text);
   }
 }
 
+void MainWindow::rs485Sent(const QByteArray &data)
+{
+  rs485RcvdDataLabel->setText(QString::fromUtf8(data));
+}
+
+void MainWindow::rs485SendFailed(const QByteArray &data, const QString &error)
+{
+  Q_UNUSED(data)
+  statusBarUi->showMessage("RS485 send error: " + error, tmpStatusMsgDelay);
+}
+
 
 
 
@@ -1712,6 +1719,7 @@ void MainWindow::writeSettings()
 
   //settings->setValue();
   settings->sync();
+  loadRadioConfig();
   statusBarUi->showMessage("Settings saved to disk", tmpStatusMsgDelay);
 }
 
@@ -1734,22 +1742,22 @@ void MainWindow::saveSettingsButtonClicked() {
     bpfChanged[i] = false;
     auxChanged[i] = false;
     gainChanged[i] = false;
-    if (settings->value(s_radioEnable[i], s_radioEnable_def).toBool() != radioEnableCheckBox[i]->isChecked()) {
+    if (radioConfig[i].enable != radioEnableCheckBox[i]->isChecked()) {
       radioEnableChanged[i] = true;
     }
-    if (settings->value(s_radioBandDecoder[i], s_radioBandDecoder_def).toInt() != radioBandDecoderComboBox[i]->currentIndex()) {
+    if (radioConfig[i].bandDecoder != radioBandDecoderComboBox[i]->currentIndex()) {
       bandDecoderChanged[i] = true;
     }
-    if (settings->value(s_radioBpf[i], s_radioBpf_def).toBool() != radioBpfCheckBox[i]->isChecked()) {
+    if (radioConfig[i].bpf != radioBpfCheckBox[i]->isChecked()) {
       bpfChanged[i] = true;
     }
-    if (settings->value(s_radioHpf[i], s_radioHpf_def).toBool() != radioHpfCheckBox[i]->isChecked()) {
+    if (radioConfig[i].hpf != radioHpfCheckBox[i]->isChecked()) {
       hpfChanged[i] = true;
     }
-    if (settings->value(s_radioAux[i], s_radioAux_def).toBool() != radioAuxCheckBox[i]->isChecked()) {
+    if (radioConfig[i].aux != radioAuxCheckBox[i]->isChecked()) {
       auxChanged[i] = true;
     }
-    if (settings->value(s_radioGain[i], s_radioGain_def).toInt() != radioGainSpinBox[i]->value()) {
+    if (radioConfig[i].gain != radioGainSpinBox[i]->value()) {
       gainChanged[i] = true;
     }
   }
@@ -1759,7 +1767,7 @@ void MainWindow::saveSettingsButtonClicked() {
 
   for (int i=0; i<NRIG; ++i){
     if (radioEnableChanged[i]) {
-      if (!settings->value(s_radioEnable[i], s_radioEnable_def).toBool()) {
+      if (!radioConfig[i].enable) {
 
         int tmpBand = currentBand[i];
         currentFreq[i] = 0;
@@ -1786,7 +1794,7 @@ void MainWindow::saveSettingsButtonClicked() {
       trackingState[i] = false;
       setAntennaLock(i, false);
       radioConnected[i] = false;
-      switch (settings->value(s_radioBandDecoder[i], s_radioBandDecoder_def).toInt()) {
+      switch (radioConfig[i].bandDecoder) {
         case kCat:
           break;
         case kSubRx:
@@ -1814,6 +1822,8 @@ void MainWindow::saveSettingsButtonClicked() {
     cbLinkedAddItems(i);
     cbLinkedSetIndex(i);
   }
+  updateRadioStates(); // apply decoder/enable changes without waiting for CAT
+  invalidateSnapshots();
 
   cronTableView->viewport()->repaint(); // updates radio names if changed
 }
@@ -1832,6 +1842,7 @@ void MainWindow::resetDatabase()
   query.exec("DROP TABLE IF EXISTS group_antenna_map");
 
   initDatabase();
+  topology.load(db);
   statusBarUi->showMessage("Database tables reset", tmpStatusMsgDelay);
   bandsTableModel->select();
   while (bandsTableModel->canFetchMore()) {
@@ -1903,6 +1914,7 @@ void MainWindow::addCron()
 void MainWindow::saveBand()
 {
   if(bandsTableModel->submitAll()) {
+    topology.load(db);
     band_groupTableModel->relationModel(1)->select();
     while (band_groupTableModel->relationModel(1)->canFetchMore()) {
       band_groupTableModel->relationModel(1)->fetchMore();
@@ -1933,6 +1945,7 @@ void MainWindow::saveBand()
 void MainWindow::saveGroup()
 {
   if(groupsTableModel->submitAll()) {
+    topology.load(db);
     group_antennaTableModel->relationModel(1)->select();
     while (group_antennaTableModel->relationModel(1)->canFetchMore()) {
       group_antennaTableModel->relationModel(1)->fetchMore();
@@ -1962,6 +1975,7 @@ void MainWindow::saveGroup()
 void MainWindow::saveAntenna()
 {
   if (antennasTableModel->submitAll()) {
+    topology.load(db);
     group_antennaTableModel->relationModel(1)->select();
     while (group_antennaTableModel->relationModel(1)->canFetchMore()) {
       group_antennaTableModel->relationModel(1)->fetchMore();
@@ -1983,6 +1997,7 @@ void MainWindow::saveAntenna()
 void MainWindow::saveBandGroup()
 {
   if(band_groupTableModel->submitAll()) {
+    topology.load(db);
     for (int i=0; i<NRIG; ++i) {
       cbGroupAddItems(i);
       groupChanged(i);
@@ -1994,6 +2009,7 @@ void MainWindow::saveBandGroup()
 void MainWindow::saveGroupAntenna()
 {
   if (group_antennaTableModel->submitAll()) {
+    topology.load(db);
     for (int i=0; i<NRIG; ++i) {
       groupChanged(i); // fake change to propagate DB changes to visual elements
     }
@@ -2116,8 +2132,8 @@ void MainWindow::removeCron()
 void MainWindow::statusPageInit() {
   for (int i=0;i<NRIG;++i) {
 
-    if (settings->value(s_radioEnable[i], s_radioEnable_def).toBool()) {
-      radioNameLabel[i]->setText(settings->value(s_radioName[i], s_radioName_def).toString());
+    if (radioConfig[i].enable) {
+      radioNameLabel[i]->setText(radioConfig[i].name);
       //radioNameLabel[i]->setStyleSheet("QLabel { color : blue; font-weight:600; }");
 
       if (currentPtt[i]) {
@@ -2128,7 +2144,7 @@ void MainWindow::statusPageInit() {
         radioPttLabel[i]->setStyleSheet("QLabel { color : green; font-weight:600; }");
       }
 
-      switch (settings->value(s_radioBandDecoder[i], s_radioBandDecoder_def).toInt()) {
+      switch (radioConfig[i].bandDecoder) {
         case kCat:
           radioCatButton[i]->setEnabled(true);
           break;
@@ -2158,18 +2174,26 @@ void MainWindow::closeEvent(QCloseEvent *event)
   writeSettings();
   delete settings;
   delete errorBox;
-  for (const auto &client : qAsConst(m_clients)) {
-    //client.websocket->abort();
-    client.websocket->deleteLater();
-  }
+  // sockets and server are deleted with wsIO when the thread finishes,
+  // anything still queued for a client id is dropped there
+  wsThread->quit();
+  wsThread->wait();
+  delete wsThread;
+  rs485Thread->quit(); // port is closed when rs485IO is deleted
+  rs485Thread->wait();
+  delete rs485Thread;
   m_clients.clear();
+  clientPeers.clear();
+  for (int i=0; i<NRIG; ++i) {
+    radioClients[i].clear();
+  }
   for (const auto &crontimer : qAsConst(cronTimers)) {
     crontimer->deleteLater();
   }
   cronTimers.clear();
-  delete webSocketServer;
   db.close();
   QSqlDatabase::removeDatabase("QSQLITE");
+  journal.close();
   for (int i=0;i<NRIG;++i) {
     if (catThread[i]->isRunning()) {
       catThread[i]->quit();
@@ -2178,6 +2202,10 @@ void MainWindow::closeEvent(QCloseEvent *event)
     cat[i]->deleteLater();
   }
 
+  logThread->quit(); // last entries are written when logger is deleted
+  logThread->wait();
+  delete logThread;
+
   event->accept();
   exit ( 0 );
 }
@@ -2199,7 +2227,7 @@ void MainWindow::bandChanged(int nrig)
   setAntennaScanning(nrig, false);
   setAntennaTracking(nrig, false);
 
-  if (settings->value(s_radioEnable[nrig], s_radioEnable_def).toBool()) {
+  if (radioConfig[nrig].enable) {
 
     int tmpAntenna = currentAntenna[nrig];
     cbGroupAddItems(nrig);
@@ -2235,25 +2263,21 @@ void MainWindow::bandChanged(int nrig)
 void MainWindow::updateBandComboSelection(int nrig)
 {
   // unsetting band will have chain effect on group and antenna
-  switch (settings->value(s_radioBandDecoder[nrig], s_radioBandDecoder_def).toInt()) {
+  switch (radioConfig[nrig].bandDecoder) {
     case kSubRx: // subRXs will follow linked RXs
       break;
     case kCat:
       {
-        QSqlQuery query(db);
-        query.exec("SELECT * from bands ORDER BY start_freq");
         bool found = false;
         int iFreqKhz = currentFreq[nrig] / 1000;
-        while (!found && query.next()) {
-          if ( iFreqKhz >= query.value("start_freq").toInt() && iFreqKhz <= query.value("stop_freq").toInt()) {
-            found = true;
-            radioBandLabel[nrig]->setText(query.value("name").toString());
-            cbBandSetText(nrig, query.value("name").toString());
-            if (currentBand[nrig] != query.value("id").toInt()) {
-              currentBand[nrig] = query.value("id").toInt();
-              bandChanged(nrig);
-            }
-            //break;
+        const Topology::Band *band = topology.band(topology.bandAtFreq(iFreqKhz, &bandHint[nrig]));
+        if (band) {
+          found = true;
+          radioBandLabel[nrig]->setText(band->name);
+          cbBandSetText(nrig, band->name);
+          if (currentBand[nrig] != band->id) {
+            currentBand[nrig] = band->id;
+            bandChanged(nrig);
           }
         }
         if (!found) { // no matching band definition
@@ -2269,17 +2293,13 @@ void MainWindow::updateBandComboSelection(int nrig)
     case kManual: // keep same band index if exists, otherwise clear
     default:
       {
-        QSqlQuery query(db);
-        query.exec("SELECT * from bands");
         bool found = false;
-        while (!found && query.next()) {
-          if ( currentBand[nrig] == query.value("id").toInt()) {
-            found = true;
-            // only need to update label and combobox selection
-            radioBandLabel[nrig]->setText(query.value("name").toString());
-            cbBandSetText(nrig, query.value("name").toString());
-            //break;
-          }
+        const Topology::Band *band = topology.band(currentBand[nrig]);
+        if (band) {
+          found = true;
+          // only need to update label and combobox selection
+          radioBandLabel[nrig]->setText(band->name);
+          cbBandSetText(nrig, band->name);
         }
         if (!found) { // no matching band definition
           if (currentBand[nrig] != 0) {
@@ -2303,16 +2323,16 @@ void MainWindow::updateBandComboSelection(int nrig)
 void MainWindow::toggleScanEnabled(int nrig)
 {
   bool enabled = false;
-  QSqlQuery query(db);
-  query.exec(QString("SELECT * from antennas where id = %1")
-                .arg(currentAntenna[nrig]));
-  if (query.first()) {
-    enabled = query.value("scan").toBool();
+  const Topology::Antenna *ant = topology.antenna(currentAntenna[nrig]);
+  if (ant) {
+    enabled = ant->scan;
   }
   // sql insert
+  QSqlQuery query(db);
   query.exec(QString("UPDATE antennas set 'scan' = %1 where id = %2")
                       .arg(!enabled)
                       .arg(currentAntenna[nrig]) );
+  topology.load(db);
 
   // reload antenna table view
   antennasTableModel->select();
@@ -2351,11 +2371,9 @@ void MainWindow::setAntennaScanning(int nrig, bool state)
           currentGroup[nrig] = prevGroupTrack[nrig];
           QString label = prevGroupLabel[nrig];
           int display_mode = getDisplayMode(currentGroup[nrig]);
-          QSqlQuery query(db);
-          query.exec(QString("select * from groups where id = %1")
-                        .arg(currentGroup[nrig]));
-          if (query.first()) {
-            label = query.value("label").toString(); // in case name changed
+          const Topology::Group *grp = topology.group(currentGroup[nrig]);
+          if (grp) {
+            label = grp->label; // in case name changed
           }
           radioGroupLabel[nrig]->setText(label);
           cbGroupSetText(nrig, label);
@@ -2380,7 +2398,12 @@ void MainWindow::setAntennaScanning(int nrig, bool state)
       }
     }
     scanState[nrig] = state;
-    scanCount[nrig] = 0;
+    scanPaused[nrig] = false;
+    if (state) {
+      scanTimer[nrig].start(currentScanDelay[nrig]);
+    } else {
+      scanTimer[nrig].stop();
+    }
     pbScanStatus(nrig, state);
   }
 }
@@ -2435,45 +2458,34 @@ void MainWindow::antennaPrev(int nrig)
 
 void MainWindow::groupStep(int nrig, bool direction)
 {
-  QSqlQuery query(db);
-  QString sql,match,sort;
-  if (nrig < 4) {
-    match.append(" and groups.radios1_4 = 1");
-  } else {
-    match.append(" and groups.radios5_8 = 1");
-  }
-  if (direction == kNext) {
-    sort.append(" order by groups.priority desc, groups.id desc");
-  } else {
-    sort.append(" order by groups.priority asc, groups.id asc");
+  // groups are ordered priority desc, id desc; walk backwards for previous
+  QVector<int> groups = topology.groupsForBand(currentBand[nrig], nrig);
+  if (direction == kPrevious) {
+    std::reverse(groups.begin(), groups.end());
   }
-  sql.append(kSelectGroupSQL.arg(currentBand[nrig])
-                            .arg(match)
-                            .arg(sort)
-                            .arg("") );
 
-  //qDebug() << sql;
   bool found = false;
   bool foundCurrent = false;
-  query.exec(sql);
-  while (!found && query.next()) {
+  for (int i = 0; !found && i < groups.size(); ++i) {
+    const Topology::Group *grp = topology.group(groups.at(i));
     if (foundCurrent) {
       // other conditions?
-      currentGroup[nrig] = query.value("id").toInt();
-      radioGroupLabel[nrig]->setText(query.value("label").toString());
-      cbGroupSetText(nrig, query.value("label").toString());
+      currentGroup[nrig] = grp->id;
+      radioGroupLabel[nrig]->setText(grp->label);
+      cbGroupSetText(nrig, grp->label);
       groupChanged(nrig);
       found = true;
     }
-    if (query.value("id").toInt() == currentGroup[nrig]) { // found current group
+    if (grp->id == currentGroup[nrig]) { // found current group
       foundCurrent = true;
     }
   }
-  if (!found && query.first()) {
-    if (currentGroup[nrig] != query.value("id").toInt()) {
-      currentGroup[nrig] = query.value("id").toInt();
-      radioGroupLabel[nrig]->setText(query.value("label").toString());
-      cbGroupSetText(nrig, query.value("label").toString());
+  if (!found && !groups.isEmpty()) {
+    const Topology::Group *grp = topology.group(groups.first());
+    if (currentGroup[nrig] != grp->id) {
+      currentGroup[nrig] = grp->id;
+      radioGroupLabel[nrig]->setText(grp->label);
+      cbGroupSetText(nrig, grp->label);
       groupChanged(nrig);
       found = true;
     }
@@ -2506,17 +2518,15 @@ MainWindow::~MainWindow()
 
 
 
+/*! open or close the RS485 port, done in the I/O thread which replies
+  with rs485Opened/rs485Closed
+*/
 void MainWindow::rs485Connection()
 {
 
-  if (rs485Serial->isOpen()) {
-    disconnect(rs485Serial, 0, 0, 0);
-    rs485Serial->close();
-    rs485RcvdDataLabel->setText("");
-    statusBarUi->showMessage("RS485 port closed", tmpStatusMsgDelay);
-    rs485Button->setText("Connect");
-    rs485Label->setStyleSheet("");
-    rs485PortComboBox->setEnabled(true);
+  if (rs485IO->isOpen()) {
+    rs485Button->setEnabled(false);
+    emit(rs485Close());
     return;
   }
 
@@ -2525,29 +2535,41 @@ void MainWindow::rs485Connection()
     return;
   }
 
-  rs485Serial->setPortName(settings->value("rs485Port", "").toString());
-  rs485Serial->setBaudRate(QSerialPort::Baud38400);
-  rs485Serial->setFlowControl(QSerialPort::NoFlowControl);
-  rs485Serial->setParity(QSerialPort::NoParity);
-  rs485Serial->setDataBits(QSerialPort::Data8);
-  rs485Serial->setStopBits(QSerialPort::OneStop);
-  rs485Serial->open(QIODevice::ReadWrite);
-  if (!rs485Serial->isOpen()) {
+  rs485Button->setEnabled(false);
+  emit(rs485Open(settings->value("rs485Port", "").toString()));
+}
+
+void MainWindow::rs485Opened(bool ok, const QString &name)
+{
+  rs485Button->setEnabled(true);
+  if (!ok) {
     statusBarUi->showMessage(QString("Can't open serial device %1")
-                              .arg(rs485Serial->portName()),
+                              .arg(name),
                               tmpStatusMsgDelay);
     return;
   }
-  rs485Serial->setRequestToSend(false); // RTS
-  rs485Serial->setDataTerminalReady(false); // DTS
-
-  connect(rs485Serial, &QSerialPort::readyRead, this, &MainWindow::rs485RcvdData);
   statusBarUi->showMessage("RS485 Port connected", tmpStatusMsgDelay);
   rs485Button->setText("Disconnect");
   rs485Label->setStyleSheet("QLabel { color : blue; }");
   rs485PortComboBox->setEnabled(false);
 }
 
+/*! closed on request (error empty) or because the device went away
+*/
+void MainWindow::rs485Closed(const QString &error)
+{
+  rs485Button->setEnabled(true);
+  rs485RcvdDataLabel->setText("");
+  if (error.isEmpty()) {
+    statusBarUi->showMessage("RS485 port closed", tmpStatusMsgDelay);
+  } else {
+    statusBarUi->showMessage("RS485 port closed: " + error, tmpStatusMsgDelay);
+  }
+  rs485Button->setText("Connect");
+  rs485Label->setStyleSheet("");
+  rs485PortComboBox->setEnabled(true);
+}
+
 void MainWindow::populateSerialPortComboBox(QComboBox* combobox) //, QString savedPort)
 {
   combobox->clear();
@@ -2568,8 +2590,26 @@ void MainWindow::populateBaudRateComboBox(QComboBox* combobox) //, QString saved
   //combobox->setCurrentText(savedBaud);
 }
 
+/*! cache per-radio settings read by the timer and switching paths
+*/
+void MainWindow::loadRadioConfig()
+{
+  for (int i=0;i<NRIG;++i) {
+    radioConfig[i].enable = settings->value(s_radioEnable[i], s_radioEnable_def).toBool();
+    radioConfig[i].pauseScan = settings->value(s_radioPauseScan[i], s_radioPauseScan_def).toBool();
+    radioConfig[i].hpf = settings->value(s_radioHpf[i], s_radioHpf_def).toBool();
+    radioConfig[i].bpf = settings->value(s_radioBpf[i], s_radioBpf_def).toBool();
+    radioConfig[i].aux = settings->value(s_radioAux[i], s_radioAux_def).toBool();
+    radioConfig[i].gain = settings->value(s_radioGain[i], s_radioGain_def).toInt();
+    radioConfig[i].bandDecoder = settings->value(s_radioBandDecoder[i], s_radioBandDecoder_def).toInt();
+    radioConfig[i].subRxNr = settings->value(s_radioSubRxNr[i], s_radioSubRxNr_def).toInt();
+    radioConfig[i].name = settings->value(s_radioName[i], s_radioName_def).toString();
+  }
+}
+
 void MainWindow::setRadioFormFromSettings()
 {
+  loadRadioConfig();
   for (int i=0;i<NRIG;++i) {
     radioEnableCheckBox[i]->setChecked(settings->value(s_radioEnable[i], s_radioEnable_def).toBool());
     radioPauseScanCheckBox[i]->setChecked(settings->value(s_radioPauseScan[i], s_radioPauseScan_def).toBool());
@@ -2619,6 +2659,8 @@ void MainWindow::radioConnection(int nrig)
 {
   // toggle
   if (catThread[nrig]->isRunning()) {
+    // timers and notifier belong to the radio thread, stop them there
+    QMetaObject::invokeMethod(cat[nrig], "stopSerial", Qt::BlockingQueuedConnection);
     catThread[nrig]->quit();
     catThread[nrig]->wait();
     radioCatButton[nrig]->setText("Start");
@@ -3340,39 +3382,440 @@ void MainWindow::about()
 
 // radio window methods ===========================
 
-void MainWindow::sendRadioWindowData(int nrig, const QJsonObject &object, QWebSocket *pClient)
-{
-  QJsonDocument doc(object);
-  QByteArray data = doc.toJson(QJsonDocument::Compact);
-  bool sent = false;
-  QString recipient = "";
-  for (const auto &client : qAsConst(m_clients)) {
-    if (pClient == nullptr) {
-      if (client.radio == nrig) {
-        client.websocket->sendBinaryMessage(data);
-        sent = true;
+void MainWindow::sendRadioWindowData(int nrig, const QJsonObject &object, quint64 pClient)
+{
+  if (pClient == 0) {
+    // state of radio changed, the co-channel radio's group list and
+    // antennas depend on it too
+    snapshot[nrig].valid = false;
+    snapshot[coChannel[nrig]].valid = false;
+    if (radioClients[nrig].isEmpty()) return;
+    queueUpdate(pendingBroadcast[nrig], object);
+  } else if (pClient == snapshotClient) {
+    queueUpdate(snapshot[nrig].updates, object);
+    return;
+  } else {
+    auto client = m_clients.constFind(pClient);
+    if (client == m_clients.constEnd()) return;
+    queueUpdate(pendingDirect[pClient], client->tagged ? tagRadio(nrig, object) : object);
+  }
+  if (!flushScheduled) {
+    flushScheduled = true;
+    QTimer::singleShot(0, this, &MainWindow::flushUpdates);
+  }
+}
+
+/*! add update to a queue, replacing an earlier one for the same
+  object/method (and radio, if tagged). the latest moves to the end so
+  the order of the surviving updates is the order they were last set
+*/
+void MainWindow::queueUpdate(QVector<pendingUpdate> &queue, const QJsonObject &object)
+{
+  QString key = object.value("object").toString() + "/" + object.value("method").toString();
+  if (object.contains("radio")) {
+    key += "/" + QString::number(object.value("radio").toInt());
+  }
+  for (int i=0; i<queue.size(); ++i) {
+    if (queue.at(i).key == key) {
+      queue.remove(i);
+      break;
+    }
+  }
+  queue << pendingUpdate{ key, object };
+}
+
+/*! send everything queued this event loop turn, one frame per client
+
+  updates for a single client (registration snapshot) go first: they were
+  taken before any broadcast still queued, which would otherwise be
+  overwritten on the client by the older snapshot. tagged clients get the
+  updates of all their radios in one frame, where a broadcast replaces
+  the snapshot update for the same object/method
+*/
+void MainWindow::flushUpdates()
+{
+  flushScheduled = false;
+  for (auto it = pendingDirect.constBegin(); it != pendingDirect.constEnd(); ++it) {
+    auto client = m_clients.constFind(it.key());
+    if (client == m_clients.constEnd()) continue;
+    if (client->tagged) {
+      QVector<pendingUpdate> updates = it.value();
+      stampVersions(m_clients[it.key()], updates);
+      QVector<pendingUpdate> &queue = pendingTagged[it.key()];
+      for (const auto &update : qAsConst(updates)) {
+        queueUpdate(queue, update.object);
       }
-      recipient = QString("[%1] ").arg(nrig+1);
     } else {
-      if (client.websocket == pClient) {
-        client.websocket->sendBinaryMessage(data);
-        sent = true;
-        recipient = QString("[%1:%2] ")
-                      .arg(pClient->peerAddress().toString())
-                      .arg(pClient->peerPort());
-        break;
+      sendFrame(client->radio, it.value(), it.key());
+    }
+  }
+  pendingDirect.clear();
+  for (int i=0; i<NRIG; ++i) {
+    if (!pendingBroadcast[i].isEmpty()) {
+      if (!radioClients[i].isEmpty()) {
+        sendFrame(i, pendingBroadcast[i]);
+      }
+      pendingBroadcast[i].clear();
+    }
+  }
+  sendTaggedFrames();
+}
+
+/*! one frame per tagged client holding everything queued for it
+*/
+void MainWindow::sendTaggedFrames()
+{
+  for (auto it = pendingTagged.constBegin(); it != pendingTagged.constEnd(); ++it) {
+    auto client = m_clients.constFind(it.key());
+    if (client == m_clients.constEnd() || it.value().isEmpty()) continue;
+    QByteArray frame = encodeFrame(it.value(), client->cbor);
+    QStringList keys;
+    bool replaces = true;
+    for (const auto &update : it.value()) {
+      keys << update.key;
+      if (update.object.value("method").toString() == QLatin1String("delta")) replaces = false;
+    }
+    emit(wsSend(it.key(), frame, keys, replaces));
+    logger->logFrame(kLogJson, frame, client->cbor, -1, clientPeers.value(it.key()));
+  }
+  pendingTagged.clear();
+}
+
+/*! copy of an update for a tagged client, with the radio it is for
+*/
+QJsonObject MainWindow::tagRadio(int nrig, const QJsonObject &object)
+{
+  QJsonObject tagged = object;
+  tagged.insert("radio", nrig + 1);
+  return tagged;
+}
+
+/*! encode once per frame variant in use and send to all subscribers of
+  radio, or only pClient
+
+  a variant is the protocol plus which delta objects are sent as delta,
+  normally all subscribers of a radio are in step and share one frame.
+  tagged clients only get their variant queued, see sendTaggedFrames
+*/
+void MainWindow::sendFrame(int nrig, const QVector<pendingUpdate> &updates, quint64 pClient)
+{
+  if (pClient == 0) {
+    QVector<pendingUpdate> full = updates;
+    QVector<pendingUpdate> delta = updates;
+    bool present[kNDeltaObjects] = {};
+    bool hasDelta[kNDeltaObjects] = {};
+    int prevVersion[kNDeltaObjects] = {};
+    for (int i=0; i<updates.size(); ++i) {
+      int d = deltaObject(updates.at(i).object);
+      if (d < 0) continue;
+      deltaState &state = radioDelta[nrig][d];
+      const QJsonArray list = updates.at(i).object.value(kWsDeltaLists[d]).toArray();
+      QJsonArray changes;
+      present[d] = true;
+      hasDelta[d] = computeDelta(state.list, list, changes);
+      prevVersion[d] = state.version;
+      state.version++;
+      state.list = list;
+      full[i].object.insert("version", state.version);
+      if (hasDelta[d]) {
+        QJsonObject object;
+        object.insert("object", kWsDeltaObjects[d]);
+        object.insert("method", QStringLiteral("delta"));
+        object.insert("base", prevVersion[d]);
+        object.insert("version", state.version);
+        object.insert(kWsDeltaLists[d], changes);
+        delta[i].object = object;
+      }
+    }
+
+    QStringList keys;
+    for (const auto &update : updates) keys << update.key;
+    auto variantFor = [&](int mask) {
+      QVector<pendingUpdate> variant = full;
+      for (int i=0; i<variant.size(); ++i) {
+        int d = deltaObject(updates.at(i).object);
+        if (d >= 0 && (mask & (1 << d))) variant[i] = delta.at(i);
+      }
+      return variant;
+    };
+    QHash<int, QByteArray> frames; // by delta mask << 1 | cbor
+    for (quint64 id : qAsConst(radioClients[nrig])) {
+      clientinfo &client = m_clients[id];
+      int mask = 0;
+      for (int d=0; d<kNDeltaObjects; ++d) {
+        if (hasDelta[d] && client.deltaVersion[nrig][d] == prevVersion[d]) mask |= 1 << d;
+        if (present[d]) client.deltaVersion[nrig][d] = radioDelta[nrig][d].version;
+      }
+      if (client.tagged) {
+        QVector<pendingUpdate> &queue = pendingTagged[id];
+        for (const auto &update : variantFor(mask)) {
+          queueUpdate(queue, tagRadio(nrig, update.object));
+        }
+        continue;
       }
+      int key = (mask << 1) | (client.cbor ? 1 : 0);
+      auto frame = frames.constFind(key);
+      if (frame == frames.constEnd()) {
+        frame = frames.insert(key, encodeFrame(variantFor(mask), client.cbor));
+        logger->logFrame(kLogJson, frame.value(), client.cbor, nrig);
+      }
+      // a frame with deltas can't replace queued frames the client still needs
+      emit(wsSend(id, frame.value(), keys, mask == 0));
     }
+  } else {
+    clientinfo &client = m_clients[pClient];
+    QVector<pendingUpdate> variant = updates;
+    stampVersions(client, variant);
+    QByteArray frame = encodeFrame(variant, client.cbor);
+    QStringList keys;
+    for (const auto &update : updates) keys << update.key;
+    emit(wsSend(pClient, frame, keys, true));
+    logger->logFrame(kLogJson, frame, client.cbor, -1, clientPeers.value(pClient));
+  }
+}
+
+/*! full state of delta objects for one client, in step with the other
+  subscribers only if it matches the last broadcast
+*/
+void MainWindow::stampVersions(clientinfo &client, QVector<pendingUpdate> &updates)
+{
+  for (int i=0; i<updates.size(); ++i) {
+    int d = deltaObject(updates.at(i).object);
+    if (d < 0) continue;
+    int nrig = client.tagged ? updates.at(i).object.value("radio").toInt() - 1 : client.radio;
+    if (nrig < 0 || nrig >= NRIG) continue;
+    const deltaState &state = radioDelta[nrig][d];
+    int version = (updates.at(i).object.value(kWsDeltaLists[d]).toArray() == state.list) ? state.version : 0;
+    updates[i].object.insert("version", version);
+    client.deltaVersion[nrig][d] = version;
+  }
+}
+
+/*! index of delta object for an update, -1 if it is always sent in full
+*/
+int MainWindow::deltaObject(const QJsonObject &object)
+{
+  if (object.value("method").toString() != QLatin1String("update")) return -1;
+  QString name = object.value("object").toString();
+  for (int d=0; d<kNDeltaObjects; ++d) {
+    if (name == kWsDeltaObjects[d]) return d;
   }
-  if (sent) {
-    jsonLog->appendPlainText("[" + QDateTime::currentDateTime().toString("hh:mm:ss")
-                             + "]"
-                             + recipient
-                             + QString::fromUtf8(data).simplified());
+  return -1;
+}
+
+/*! entries of list that differ from base, only the changed fields and
+  their index. false if no delta is possible (no base, size changed)
+*/
+bool MainWindow::computeDelta(const QJsonArray &base, const QJsonArray &list, QJsonArray &changes)
+{
+  if (base.isEmpty() || base.size() != list.size()) return false;
+  for (int i=0; i<list.size(); ++i) {
+    if (base.at(i) == list.at(i)) continue;
+    if (!base.at(i).isObject() || !list.at(i).isObject()) return false;
+    const QJsonObject b = base.at(i).toObject();
+    const QJsonObject n = list.at(i).toObject();
+    if (b.size() != n.size()) return false;
+    QJsonObject change;
+    change.insert("index", i);
+    for (auto it = n.constBegin(); it != n.constEnd(); ++it) {
+      if (!b.contains(it.key())) return false;
+      if (b.value(it.key()) != it.value()) change.insert(it.key(), it.value());
+    }
+    changes.append(change);
   }
+  return true;
 }
 
-void MainWindow::frameSetEnabled(int nrig, bool state, QWebSocket *pClient)
+/*! client lost track of a delta object, send full state
+*/
+void MainWindow::resyncClient(int nrig, quint64 pClient)
+{
+  for (int d=0; d<kNDeltaObjects; ++d) {
+    m_clients[pClient].deltaVersion[nrig][d] = 0;
+  }
+  int display_mode = getDisplayMode(currentGroup[nrig]);
+  if (currentGroup[nrig] > 0) {
+    if (display_mode == kDispList) {
+      updateAntennaButtonsSelection(nrig, pClient);
+    } else if (display_mode == kDispCompass) {
+      updateGraphicsLabels(nrig, pClient);
+      updateGraphicsEllipse(nrig, pClient);
+    }
+  }
+}
+
+/*! a single update is sent as a plain object (map), several as an array
+*/
+QByteArray MainWindow::encodeFrame(const QVector<pendingUpdate> &updates, bool cbor)
+{
+  if (cbor) {
+    if (updates.size() == 1) {
+      return cborUpdate(updates.first().object).toCborValue().toCbor();
+    }
+    QCborArray array;
+    for (const auto &update : updates) {
+      array.append(cborUpdate(update.object));
+    }
+    return QCborValue(array).toCbor();
+  }
+  if (updates.size() == 1) {
+    return QJsonDocument(updates.first().object).toJson(QJsonDocument::Compact);
+  }
+  QJsonArray array;
+  for (const auto &update : updates) {
+    array.append(update.object);
+  }
+  return QJsonDocument(array).toJson(QJsonDocument::Compact);
+}
+
+/*! CBOR form of an update, object and method names replaced by their
+  numeric ids under integer keys 0 and 1
+*/
+QCborMap MainWindow::cborUpdate(const QJsonObject &object)
+{
+  QCborMap map = QCborMap::fromJsonObject(object);
+  int objectId = kWsObjects.indexOf(object.value("object").toString());
+  int methodId = kWsMethods.indexOf(object.value("method").toString());
+  if (objectId >= 0 && methodId >= 0) {
+    map.remove(QStringLiteral("object"));
+    map.remove(QStringLiteral("method"));
+    map.insert(0, objectId);
+    map.insert(1, methodId);
+  }
+  return map;
+}
+
+/*! queue the registration state of radio for one client as a single
+  frame, from the cached snapshot if the radio has not changed since
+*/
+void MainWindow::sendSnapshot(int nrig, quint64 pClient)
+{
+  if (!snapshot[nrig].valid || snapshot[nrig].generation != topology.loadGeneration()) {
+    buildSnapshot(nrig, pClient);
+  }
+  bool tagged = m_clients.value(pClient).tagged;
+  QVector<pendingUpdate> &queue = pendingDirect[pClient];
+  for (const auto &update : qAsConst(snapshot[nrig].updates)) {
+    queueUpdate(queue, tagged ? tagRadio(nrig, update.object) : update.object);
+  }
+  if (!flushScheduled) {
+    flushScheduled = true;
+    QTimer::singleShot(0, this, &MainWindow::flushUpdates);
+  }
+}
+
+/*! run the client window setup once, capturing what it sends
+
+  pClient is only used to capture the updates. group selection may
+  change the radio state while building, which leaves the snapshot
+  invalid for the next registration
+*/
+void MainWindow::buildSnapshot(int nrig, quint64 pClient)
+{
+  snapshot[nrig].updates.clear();
+  snapshot[nrig].valid = true;
+  snapshot[nrig].generation = topology.loadGeneration();
+  snapshotClient = pClient;
+
+  radioNameSetText(nrig, pClient);
+  radioConnectionStatus(nrig, radioConnected[nrig], pClient); // cat[nrig]->radioOpen());
+  cbBandAddItems(nrig, pClient);
+  //updateBandComboSelection(nrig);
+  cbBandSetText(nrig, radioBandLabel[nrig]->text(), pClient);
+  cbBandSetEnabled(nrig, pClient); // not effected by lock state
+  bearingLabelText(nrig, pClient);
+
+  cbLinkedAddItems(nrig, pClient);
+  cbLinkedSetIndex(nrig, pClient);
+  cbScanDelayAddItems(nrig, pClient);
+  cbScanDelaySetIndex(nrig, pClient);
+  pbScanEnabledStatus(nrig, pClient);
+  cbGroupAddItems(nrig, pClient);
+  lbPttState(nrig, pClient);
+  lbHpfSetText(nrig, pClient);
+  lbBpfSetText(nrig, pClient);
+  lbGainSetText(nrig, pClient);
+  lbAuxSetText(nrig, pClient);
+
+  int display_mode = getDisplayMode(currentGroup[nrig]);
+
+  if (currentGroup[nrig] > 0) {
+    if (display_mode == kDispList) {
+      createAntennaButtons(nrig, pClient);
+      updateAntennaButtonsSelection(nrig, pClient);
+      setLayoutIndex(nrig, kDispList, pClient);
+    } else if (display_mode == kDispCompass) {
+      updateGraphicsLines(nrig, pClient);
+      updateGraphicsLabels(nrig, pClient);
+      updateGraphicsEllipse(nrig, pClient);
+      setLayoutIndex(nrig, kDispCompass, pClient);
+    } else {
+      setLayoutIndex(nrig, kDispNone, pClient);
+    }
+  } else {
+    setLayoutIndex(nrig, kDispNone, pClient);
+  }
+  //if (scanState[nrig]) {
+    pbScanStatus(nrig, scanState[nrig], pClient);
+  //} else if (trackingState[nrig]) {
+    pbTrackStatus(nrig, trackingState[nrig], pClient);
+  if (trackingState[nrig]) {
+    cbLinkedSetEnabled(nrig, false, pClient);
+  }
+  //} else if (lockState[nrig]) {
+    pbLockStatus(nrig, lockState[nrig], pClient);
+  if (lockState[nrig]) {
+    cbGroupSetEnabled(nrig, false, pClient);
+    pbScanSetEnabled(nrig, false, pClient);
+    pbTrackSetEnabled(nrig, false, pClient);
+    cbLinkedSetEnabled(nrig, false, pClient);
+    cbScanDelaySetEnabled(nrig, false, pClient);
+    frameSetEnabled(nrig, false, pClient);
+  }
+
+  snapshotClient = 0;
+}
+
+/*! radio configuration changed outside of broadcasts
+*/
+void MainWindow::invalidateSnapshots()
+{
+  for (int i=0; i<NRIG; ++i) {
+    snapshot[i].valid = false;
+  }
+}
+
+/*! id tables of the binary protocol, first message to a CBOR client
+*/
+void MainWindow::sendProtocolIds(int nrig, quint64 pClient)
+{
+  QJsonObject object;
+  object.insert("object", QJsonValue::fromVariant("protocol"));
+  object.insert("method", QJsonValue::fromVariant("ids"));
+  object.insert("objects", QJsonArray::fromStringList(kWsObjects));
+  object.insert("methods", QJsonArray::fromStringList(kWsMethods));
+  sendRadioWindowData(nrig, object, pClient);
+}
+
+/*! entries from the logger, views scrolled to the bottom follow new
+  entries
+*/
+void MainWindow::logEntries(const QVector<LogEntry> &entries)
+{
+  QVector<LogEntry> batch[kNLogs];
+  for (const auto &entry : entries) {
+    batch[entry.log] << entry;
+  }
+  for (int i=0; i<kNLogs; ++i) {
+    if (batch[i].isEmpty()) continue;
+    QScrollBar *bar = logViews[i]->verticalScrollBar();
+    bool follow = (bar->value() == bar->maximum());
+    logModels[i]->append(batch[i]);
+    if (follow) logViews[i]->scrollToBottom();
+  }
+}
+
+void MainWindow::frameSetEnabled(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("frame"));
@@ -3381,7 +3824,7 @@ void MainWindow::frameSetEnabled(int nrig, bool state, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::lbPttState(int nrig, QWebSocket *pClient) {
+void MainWindow::lbPttState(int nrig, quint64 pClient) {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("ptt"));
   object.insert("method", QJsonValue::fromVariant("state"));
@@ -3389,16 +3832,16 @@ void MainWindow::lbPttState(int nrig, QWebSocket *pClient) {
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::radioNameSetText(int nrig, QWebSocket *pClient)
+void MainWindow::radioNameSetText(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("radioName"));
   object.insert("method", QJsonValue::fromVariant("setText"));
-  object.insert("text", QJsonValue::fromVariant(settings->value(s_radioName[nrig], s_radioName_def).toString()));
+  object.insert("text", QJsonValue::fromVariant(radioConfig[nrig].name));
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::radioConnectionStatus(int nrig, bool state, QWebSocket *pClient)
+void MainWindow::radioConnectionStatus(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("radioName"));
@@ -3412,12 +3855,12 @@ void MainWindow::radioConnectionStatus(int nrig, bool state, QWebSocket *pClient
   }
 }
 
-void MainWindow::cbBandSetEnabled(int nrig, QWebSocket *pClient)
+void MainWindow::cbBandSetEnabled(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbBand"));
   object.insert("method", QJsonValue::fromVariant("setEnabled"));
-  if (settings->value(s_radioBandDecoder[nrig], s_radioBandDecoder_def).toInt() == kManual) {
+  if (radioConfig[nrig].bandDecoder == kManual) {
     object.insert("state", QJsonValue::fromVariant(true));
   } else {
     object.insert("state", QJsonValue::fromVariant(false));
@@ -3425,23 +3868,21 @@ void MainWindow::cbBandSetEnabled(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbBandAddItems(int nrig, QWebSocket *pClient)
+void MainWindow::cbBandAddItems(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbBand"));
   object.insert("method", QJsonValue::fromVariant("addItem"));
   QJsonArray labels;
   labels.push_back(QJsonValue::fromVariant(""));
-  QSqlQuery query(db);
-  query.exec("SELECT * from bands ORDER BY start_freq");
-  while (query.next()) {
-    labels.push_back(QJsonValue::fromVariant(query.value("name").toString()));
+  for (int id : topology.bandsByFreq()) {
+    labels.push_back(QJsonValue::fromVariant(topology.band(id)->name));
   }
   object.insert("labels", QJsonValue(labels));
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbBandSetText(int nrig, QString text, QWebSocket *pClient)
+void MainWindow::cbBandSetText(int nrig, QString text, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbBand"));
@@ -3452,19 +3893,15 @@ void MainWindow::cbBandSetText(int nrig, QString text, QWebSocket *pClient)
 
 void MainWindow::cbBandChanged(int nrig, QString text)
 {
-  QSqlQuery query(db);
-  query.exec("SELECT * from bands");
   bool found = false;
-  while (!found && query.next()) {
-    if ( text == query.value("name").toString()) {
-      found = true;
-      if (query.value("id").toInt() != currentBand[nrig]) { // band changed
-        radioBandLabel[nrig]->setText(query.value("name").toString());
-        cbBandSetText(nrig, query.value("name").toString()); // update all clients
-        currentBand[nrig] = query.value("id").toInt();
-        bandChanged(nrig);
-        //break;
-      }
+  const Topology::Band *band = topology.bandByName(text);
+  if (band) {
+    found = true;
+    if (band->id != currentBand[nrig]) { // band changed
+      radioBandLabel[nrig]->setText(band->name);
+      cbBandSetText(nrig, band->name); // update all clients
+      currentBand[nrig] = band->id;
+      bandChanged(nrig);
     }
   }
   if (!found) { // no matching band definition
@@ -3477,7 +3914,7 @@ void MainWindow::cbBandChanged(int nrig, QString text)
   }
 }
 
-void MainWindow::pbScanStatus(int nrig, bool state, QWebSocket *pClient)
+void MainWindow::pbScanStatus(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("pbScan"));
@@ -3486,7 +3923,7 @@ void MainWindow::pbScanStatus(int nrig, bool state, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::pbScanSetEnabled(int nrig, bool state, QWebSocket *pClient)
+void MainWindow::pbScanSetEnabled(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("pbScan"));
@@ -3495,14 +3932,12 @@ void MainWindow::pbScanSetEnabled(int nrig, bool state, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::pbScanEnabledStatus(int nrig, QWebSocket *pClient)
+void MainWindow::pbScanEnabledStatus(int nrig, quint64 pClient)
 {
   bool state = false;
-  QSqlQuery query(db);
-  query.exec(QString("SELECT * from antennas where id = %1")
-                        .arg(currentAntenna[nrig]) );
-  if (query.first()) {
-    state = query.value("scan").toBool();
+  const Topology::Antenna *ant = topology.antenna(currentAntenna[nrig]);
+  if (ant) {
+    state = ant->scan;
   }
 
   QJsonObject object;
@@ -3512,7 +3947,7 @@ void MainWindow::pbScanEnabledStatus(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::pbLockStatus(int nrig, bool state, QWebSocket *pClient)
+void MainWindow::pbLockStatus(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("pbLock"));
@@ -3521,7 +3956,7 @@ void MainWindow::pbLockStatus(int nrig, bool state, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::pbTrackSetEnabled(int nrig, bool state, QWebSocket *pClient)
+void MainWindow::pbTrackSetEnabled(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("pbTrack"));
@@ -3530,7 +3965,7 @@ void MainWindow::pbTrackSetEnabled(int nrig, bool state, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::pbTrackStatus(int nrig, bool state, QWebSocket *pClient)
+void MainWindow::pbTrackStatus(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("pbTrack"));
@@ -3539,7 +3974,7 @@ void MainWindow::pbTrackStatus(int nrig, bool state, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbLinkedSetEnabled(int nrig, bool state, QWebSocket *pClient)
+void MainWindow::cbLinkedSetEnabled(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbLinked"));
@@ -3548,7 +3983,7 @@ void MainWindow::cbLinkedSetEnabled(int nrig, bool state, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbLinkedAddItems(int nrig, QWebSocket *pClient)
+void MainWindow::cbLinkedAddItems(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbLinked"));
@@ -3556,13 +3991,13 @@ void MainWindow::cbLinkedAddItems(int nrig, QWebSocket *pClient)
   QJsonArray items;
   for (int i=0; i<NRIG; ++i) {
     QJsonObject item;
-    if (settings->value(s_radioName[i], "").toString().isEmpty()) {
+    if (radioConfig[i].name.isEmpty()) {
       item.insert("label", QJsonValue::fromVariant(QString::number(i+1)+" -------"));
     } else {
-      item.insert("label", QJsonValue::fromVariant(settings->value(s_radioName[i], "").toString()));
+      item.insert("label", QJsonValue::fromVariant(radioConfig[i].name));
     }
 
-    if (settings->value(s_radioEnable[i], s_radioEnable_def).toBool() &&
+    if (radioConfig[i].enable &&
         i != nrig) {
       item.insert("enabled", QJsonValue::fromVariant(true));
     } else {
@@ -3574,7 +4009,7 @@ void MainWindow::cbLinkedAddItems(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbLinkedSetIndex(int nrig, QWebSocket *pClient)
+void MainWindow::cbLinkedSetIndex(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbLinked"));
@@ -3583,7 +4018,7 @@ void MainWindow::cbLinkedSetIndex(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbScanDelaySetEnabled(int nrig, bool state, QWebSocket *pClient)
+void MainWindow::cbScanDelaySetEnabled(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbScanDelay"));
@@ -3592,7 +4027,7 @@ void MainWindow::cbScanDelaySetEnabled(int nrig, bool state, QWebSocket *pClient
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbScanDelayAddItems(int nrig, QWebSocket *pClient)
+void MainWindow::cbScanDelayAddItems(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbScanDelay"));
@@ -3607,7 +4042,7 @@ void MainWindow::cbScanDelayAddItems(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbScanDelaySetIndex(int nrig, QWebSocket *pClient)
+void MainWindow::cbScanDelaySetIndex(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbScanDelay"));
@@ -3617,7 +4052,7 @@ void MainWindow::cbScanDelaySetIndex(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::bearingLabelText(int nrig, QWebSocket *pClient)
+void MainWindow::bearingLabelText(int nrig, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("bearingLabel"));
@@ -3630,7 +4065,7 @@ void MainWindow::bearingLabelText(int nrig, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbGroupSetEnabled(int nrig, bool state, QWebSocket *pClient)
+void MainWindow::cbGroupSetEnabled(int nrig, bool state, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbGroup"));
@@ -3639,36 +4074,23 @@ void MainWindow::cbGroupSetEnabled(int nrig, bool state, QWebSocket *pClient)
   sendRadioWindowData(nrig, object, pClient);
 }
 
-void MainWindow::cbGroupAddItems(int nrig, QWebSocket *pClient)
+void MainWindow::cbGroupAddItems(int nrig, quint64 pClient)
 {
   bool found = false;
-  QSqlQuery query(db);
-  QString sql,match,sort;
-  if (nrig < 4) {
-    match.append(" and groups.radios1_4 = 1");
-  } else {
-    match.append(" and groups.radios5_8 = 1");
-  }
-  sort.append(" order by groups.priority desc, groups.id desc");
-  sql.append(kSelectGroupSQL.arg(currentBand[nrig])
-                            .arg(match)
-                            .arg(sort)
-                            .arg("") );
-
-  //qDebug() << sql;
-  query.exec(sql);
+  const QVector<int> &groups = topology.groupsForBand(currentBand[nrig], nrig);
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbGroup"));
   object.insert("method", QJsonValue::fromVariant("addItem"));
   QJsonArray labels;
   labels.push_back(QJsonValue::fromVariant(""));
   QString bandText = QStringLiteral("");
-  while (query.next()) {
-    if (selectAntenna(nrig, false, query.value("id").toInt())) { // only add if has valid antennas
-      labels.push_back(QJsonValue::fromVariant(query.value("label").toString()));
+  for (int id : groups) {
+    if (selectAntenna(nrig, false, id)) { // only add if has valid antennas
+      const Topology::Group *grp = topology.group(id);
+      labels.push_back(QJsonValue::fromVariant(grp->label));
       // find current group and re-select
-      if (query.value("id").toInt() == currentGroup[nrig]) {
-        bandText = query.value("label").toString();
+      if (grp->id == currentGroup[nrig]) {
+        bandText = grp->label;
         found = true;
       }
     }
@@ -3686,12 +4108,13 @@ void MainWindow::cbGroupAddItems(int nrig, QWebSocket *pClient)
   }
 
   // go to highest priority group if one exists
-  if (!found && query.first()) {
-    if (selectAntenna(nrig, false, query.value("id").toInt())) { // only add if has valid antennas
+  if (!found && !groups.isEmpty()) {
+    if (selectAntenna(nrig, false, groups.first())) { // only add if has valid antennas
+      const Topology::Group *grp = topology.group(groups.first());
       found = true;
-      cbGroupSetText(nrig, query.value("label").toString(), pClient);
-      radioGroupLabel[nrig]->setText(query.value("label").toString());
-      currentGroup[nrig] = query.value("id").toInt();
+      cbGroupSetText(nrig, grp->label, pClient);
+      radioGroupLabel[nrig]->setText(grp->label);
+      currentGroup[nrig] = grp->id;
       groupChanged(nrig);
     }
   }
@@ -3706,7 +4129,7 @@ void MainWindow::cbGroupAddItems(int nrig, QWebSocket *pClient)
   }
 }
 
-void MainWindow::cbGroupSetText(int nrig, QString text, QWebSocket *pClient)
+void MainWindow::cbGroupSetText(int nrig, QString text, quint64 pClient)
 {
   QJsonObject object;
   object.insert("object", QJsonValue::fromVariant("cbGroup"));
@@ -3717,41 +4140,26 @@ void MainWindow::cbGroupSetText(int nrig, QString text, QWebSocket *pClient)
 
 void MainWindow::cbGroupChanged(int nrig, QString text)
 {
-  QSqlQuery query(db);
-  //query.exec("SELECT * from groups");
-  QString sql,match,sort;
-  if (nrig < 4) {
-    match.append(" and groups.radios1_4 = 1");
-  } else {
-    match.append(" and groups.radios5_8 = 1");
-  }
-  sort.append(" order by groups.priority desc, groups.id desc");
-  sql.append(kSelectGroupSQL.arg(currentBand[nrig])
-                            .arg(match)
-                            .arg(sort)
-                            .arg("") );
-
-  //qDebug() << sql;
-  query.exec(sql);
   bool found = false;
-  while (!found && query.next()) {
-    if ( text == query.value("label").toString()) {
+  for (int id : topology.groupsForBand(currentBand[nrig], nrig)) {
+    const Topology::Group *grp = topology.group(id);
+    if ( text == grp->label) {
       found = true;
-      if (query.value("id").toInt() != currentGroup[nrig]) { // group changed
-        radioGroupLabel[nrig]->setText(query.value("label").toString());
-        cbGroupSetText(nrig, query.value("label").toString());
-        currentGroup[nrig] = query.value("id").toInt();
+      if (grp->id != currentGroup[nrig]) { // group changed
+        radioGroupLabel[nrig]->setText(grp->label);
+        cbGroupSetText(nrig, grp->label);
+        currentGroup[nrig] = grp->id;
         if (trackingState[nrig]) {
           if (currentGroup[nrig] == currentGroup[currentTrackedRadio[nrig]]) {
             setAntennaTracking(nrig, false);
           }
-          if (query.value("display_mode").toInt() != kDispCompass) {
+          if (grp->display_mode != kDispCompass) {
             setAntennaTracking(nrig, false);
           }
         }
         groupChanged(nrig);
-        //break;
       }
+      break;
     }
   }
   if (!found) { // group not found
@@ -3795,68 +4203,85 @@ void MainWindow::connectMainWindowSignals()
 
 
 // WEBSOCKET
-void MainWindow::socketDisconnected()
+void MainWindow::socketDisconnected(quint64 pClient)
 {
-  QWebSocket *pClient = qobject_cast<QWebSocket *>(sender());
   //qDebug() << "disconnect " << pClient->peerAddress().toString() << ":" << pClient->peerPort();
   //statusBarUi->showMessage("Client "+pClient->peerAddress().toString()+":"
   //                         +QString::number(pClient->peerPort())+" disconnected", tmpStatusMsgDelay);
-  int nrig = -1;
+  quint32 radios = 0;
   if (pClient) {
-    for (int i=0; i < m_clients.count(); ++i) {
-      if (m_clients.at(i).websocket == pClient) {
-        nrig = m_clients.at(i).radio;
-        m_clients.removeAt(i);
-        serverLog->appendPlainText(QString("[%1] %2:%3 disconnected")
-                                      .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                      .arg(pClient->peerAddress().toString())
-                                      .arg(pClient->peerPort()));
-        break;
-      }
+    auto it = m_clients.find(pClient);
+    if (it != m_clients.end()) {
+      radios = it->radios;
+      m_clients.erase(it);
+      pendingDirect.remove(pClient);
+      pendingTagged.remove(pClient);
+      logger->log(kLogServer, "disconnected", -1, clientPeers.value(pClient));
     }
     //m_clients.removeAll(pClient);
-    pClient->deleteLater();
+    clientPeers.remove(pClient); // socket itself is deleted by wsIO
   }
-  if (nrig >= 0) { // check if any other clients for radio
-    int cnt=0;
-    for (const auto &client : qAsConst(m_clients)) {
-      if (client.radio == nrig) {
-        cnt++;
-      }
+  for (int i=0; i<NRIG; ++i) { // check if any other clients for radio
+    if (radios & (1u << i)) {
+      radioClients[i].removeOne(pClient);
+      radioClientsChanged(i);
     }
-    if (cnt > 0) {
-      clientsLabel[nrig]->setText(QString::number(cnt));
-    } else { // no other clients registered for radio, do some cleanup
-      setAntennaLock(nrig, false);
-      setAntennaScanning(nrig, false);
-      setAntennaTracking(nrig, false);
+  }
+}
 
-      clientsLabel[nrig]->setText("");
-      //qDebug() << "No clients left for radio " << nrig+1 << ", cleared lock/scan/tracking states";
-      statusBarUi->showMessage(QString("No clients left for radio %1, cleared states")
-                                    .arg(nrig+1),
-                                    tmpStatusMsgDelay);
+/*! wsIO is dropping a client that stopped reading, disconnect follows
+*/
+void MainWindow::slowClient(quint64 pClient, int dropped, quint64 total)
+{
+  logger->log(kLogServer, QString("not reading, disconnecting (%1 frames dropped, %2 slow clients total)")
+                             .arg(dropped)
+                             .arg(total),
+              -1, clientPeers.value(pClient));
+}
+
+/*! queued frames replaced by newer ones before they could be sent
+*/
+void MainWindow::framesDropped(quint64 dropped, quint64 total)
+{
+  logger->log(kLogServer, QString("%1 superseded frames dropped (%2 total)")
+                             .arg(dropped)
+                             .arg(total));
+}
+
+/*! rigctld pipeline counters of each radio using it, as tooltip of the
+  radio name and in the server log while replies are coming in
+*/
+void MainWindow::rigctldStats()
+{
+  for (int i=0; i<NRIG; ++i) {
+    if (!cat[i] || !radioConfig[i].enable || !settings->value(s_rigctld[i], s_rigctld_def).toBool()) {
+      radioNameLabel[i]->setToolTip("");
+      continue;
+    }
+    RigctldStats stats = cat[i]->rigctldStats();
+    QString text = QString("rigctld rtt %1 ms (avg %2, min %3, max %4), %5 replies, %6 timeouts, %7 polls skipped")
+                     .arg(stats.lastRtt)
+                     .arg(stats.avgRtt, 0, 'f', 1)
+                     .arg(stats.minRtt)
+                     .arg(stats.maxRtt)
+                     .arg(stats.replies)
+                     .arg(stats.timeouts)
+                     .arg(stats.skipped);
+    radioNameLabel[i]->setToolTip(text);
+    if (stats.replies != rigctldReplies[i]) {
+      rigctldReplies[i] = stats.replies;
+      logger->log(kLogServer, text, i);
     }
   }
 }
 
-void MainWindow::onNewConnection()
+/*! new socket accepted by wsIO, known here only by its id
+*/
+void MainWindow::clientConnected(quint64 id, const QString &peer)
 {
-  auto pSocket = webSocketServer->nextPendingConnection();
-  pSocket->setParent(this);
-  //connect(pSocket, &QWebSocket::textMessageReceived,
-  connect(pSocket, &QWebSocket::binaryMessageReceived,
-            this, &MainWindow::processMessage);
-  connect(pSocket, &QWebSocket::disconnected,
-            this, &MainWindow::socketDisconnected);
-  //m_clients << pSocket;
-  //qDebug() << "connect " << pSocket->peerAddress().toString() << ":" << pSocket->peerPort();
-  //statusBarUi->showMessage(pSocket->peerAddress().toString()+":"
-  //                         +QString::number(pSocket->peerPort())+" connected", tmpStatusMsgDelay);
-  serverLog->appendPlainText(QString("[%1] %2:%3 new connection")
-                                  .arg(QDateTime::currentDateTime().toString("hh:mm:ss"))
-                                  .arg(pSocket->peerAddress().toString())
-                                  .arg(pSocket->peerPort()));
+  clientPeers.insert(id, peer);
+  //qDebug() << "connect " << peer;
+  logger->log(kLogServer, "new connection", -1, peer);
 }
 
 
@@ -3872,71 +4297,50 @@ void MainWindow::antennaStep(int nrig, bool direction, bool scanable)
   int display_mode = getDisplayMode(currentGroup[nrig]);
   int coChannelPort = getSwitchPort(currentAntenna[ coChannel[nrig] ]); // antenna switch port of co-channel radio
 
-  QSqlQuery query(db);
-  QString sql,match,sort;
-  // radio range
-  if (nrig < 4) {
-    match.append(" and antennas.radios1_4 = 1");
-  } else {
-    match.append(" and antennas.radios5_8 = 1");
-  }
-  match.append(QString(" and antennas.switch_port <> %1")
-                    .arg(coChannelPort));
-  if (display_mode == kDispCompass) {
-    if (direction == kNext) {
-      sort.append(" order by antennas.start_deg asc");
-    } else {
-      sort.append(" order by antennas.start_deg desc");
-    }
-  } else {
-    if (direction == kNext) {
-      sort.append(" order by antennas.priority desc, antennas.id asc");
-    } else {
-      sort.append(" order by antennas.priority asc, antennas.id desc");
+  // ordered start_deg asc (compass) or priority desc, id asc (list),
+  // walk backwards for previous
+  QVector<int> antennas;
+  const QVector<int> &ordered = (display_mode == kDispCompass) ?
+                                 topology.antennasByBearing(currentGroup[nrig], nrig) :
+                                 topology.antennasByPriority(currentGroup[nrig], nrig);
+  // filter out co-channel antenna port conflict
+  for (int id : ordered) {
+    if (topology.switchPort(id) != coChannelPort) {
+      antennas << id;
     }
   }
-  sql.append(kSelectAntennaSQL.arg(currentGroup[nrig])
-                              .arg(match)
-                              .arg(sort) );
-
-  //if (scanable) {
-  //  sql.append(" and scan = 1");
-  //}
-  // fitler out co-channel antenna port conflict
-  //qDebug() << coChannel[nrig] + 1 << " " << coChannelPort;
+  if (direction == kPrevious) {
+    std::reverse(antennas.begin(), antennas.end());
+  }
 
-  //qDebug() << sql;
   bool found = false;
   bool foundCurrent = false;
-  query.exec(sql);
-
-  while (!found && query.next()) {
-    if (foundCurrent && ( (scanable && query.value("scan").toBool()) || !scanable) ) {
+  for (int i = 0; !found && i < antennas.size(); ++i) {
+    const Topology::Antenna *ant = topology.antenna(antennas.at(i));
+    if (foundCurrent && ( (scanable && ant->scan) || !scanable) ) {
       // other conditions?
       found = true;
-      currentAntenna[nrig] = query.value("id").toInt();
+      currentAntenna[nrig] = ant->id;
       //if (display_mode == kDispCompass) {
-        currentBearing[nrig] = calcCenterBearing(query.value("start_deg").toInt(), query.value("stop_deg").toInt());
+        currentBearing[nrig] = calcCenterBearing(ant->start_deg, ant->stop_deg);
         bearingChanged(nrig);
       //} else {
       //  currentBearing[nrig] = -1;
       //}
       antennaChanged(nrig);
     }
-    if (currentAntenna[nrig] == query.value("id").toInt()) { // found current antenna
+    if (currentAntenna[nrig] == ant->id) { // found current antenna
       foundCurrent = true;
     }
   }
-  if (!found) {
-    query.seek(QSql::BeforeFirstRow);
-  }
-  while (!found && query.next()) {
-    if (currentAntenna[nrig] != query.value("id").toInt()) { // no action if back to current antenna
-      if ( (scanable && query.value("scan").toBool()) || !scanable ) {
+  for (int i = 0; !found && i < antennas.size(); ++i) {
+    const Topology::Antenna *ant = topology.antenna(antennas.at(i));
+    if (currentAntenna[nrig] != ant->id) { // no action if back to current antenna
+      if ( (scanable && ant->scan) || !scanable ) {
         found = true;
-        currentAntenna[nrig] = query.value("id").toInt();
+        currentAntenna[nrig] = ant->id;
         //if (display_mode == kDispCompass) {
-          currentBearing[nrig] = calcCenterBearing(query.value("start_deg").toInt(), query.value("stop_deg").toInt());
+          currentBearing[nrig] = calcCenterBearing(ant->start_deg, ant->stop_deg);
           bearingChanged(nrig);
         //} else {
         //  currentBearing[nrig] = -1;
@@ -3955,23 +4359,9 @@ void MainWindow::antennaStep(int nrig, bool direction, bool scanable)
 
 int MainWindow::getDisplayMode(int group)
 {
-  int display_mode = kDispNone;
-  QSqlQuery query(db);
-  query.exec(QString("SELECT display_mode from groups where id = %1")
-                      .arg(group) );
-  if (query.first()) {
-    display_mode = query.value("display_mode").toInt();
-  }
-  return display_mode;
+  return topology.displayMode(group);
 }
 int MainWindow::getSwitchPort(int antenna)
 {
-  int port = -1;
-  QSqlQuery query(db);
-  query.exec(QString("SELECT switch_port from antennas where id = %1")
-                      .arg(antenna) );
-  if (query.first()) {
-    port = query.value("switch_port").toInt();
-  }
-  return port;
+  return topology.switchPort(antenna);
 }
@@ -9,15 +9,32 @@
 #include "ui_mainwindow.h"
 #include "serial.hpp"
 #include "delegates.hpp"
+#include "topology.hpp"
+#include "websocketio.hpp"
+#include "logger.hpp"
+#include "logmodel.hpp"
+#include "journal.hpp"
+#include "rs485io.hpp"
 
 const int tmpStatusMsgDelay = 2000;
-const int timerPeriod = 50;
 
 typedef struct {
   QPushButton *button;
   int antenna;
 } AntennaButton;
 
+struct RadioConfig {
+  bool enable;
+  bool pauseScan;
+  bool hpf;
+  bool bpf;
+  bool aux;
+  int gain;
+  int bandDecoder;
+  int subRxNr;
+  QString name;
+};
+
 class RigSerial;
 
 class MainWindow : public QMainWindow, private Ui::MainWindow
@@ -30,7 +47,8 @@ public:
 
 private:
   QLabel        *rs485RcvdDataLabel;
-  QSerialPort   *rs485Serial;
+  QThread       *rs485Thread;
+  Rs485IO       *rs485IO;  // port, lives in rs485Thread
   QSettings     *settings;
   QSqlDatabase  db;
   QSqlTableModel *bandsTableModel;
@@ -39,9 +57,22 @@ private:
   QSqlRelationalTableModel *band_groupTableModel;
   QSqlRelationalTableModel *group_antennaTableModel;
   QSqlRelationalTableModel *cronTableModel;
+  Topology      topology;
   QThread       *catThread[NRIG];
   QErrorMessage *errorBox;
-  QTimer  mainTimer{this};
+  QTimer  scanTimer[NRIG];
+  // bearings from clients waiting to be applied, -1 none
+  QTimer  bearingTimer[NRIG];
+  QElapsedTimer bearingApplied[NRIG];
+  int pendingBearing[NRIG];
+  int bearingInterval;
+  // rigctld round trip and drop counters, logged and shown as tooltip
+  QTimer  rigctldStatsTimer;
+  quint32 rigctldReplies[NRIG] = {};
+  void rigctldStats();
+  void queueBearing(int, int);
+  void applyPendingBearing(int);
+  void applyPendingBearings();
   QFileDialog directoryDialog{this};
   struct cronTimer {
     QTimer *timer;
@@ -55,50 +86,124 @@ private:
   void cronStop();
 
   // websockets
-  QWebSocketServer *webSocketServer;
+  QThread *wsThread;
+  WebSocketIO *wsIO;  // server and sockets, lives in wsThread
+  // clients are known by the id wsIO gives each connection, never reused
+  QHash<quint64, QString> clientPeers; // "address:port" of connected clients
   //QList<QWebSocket *> m_clients;
   struct clientinfo {
-    QWebSocket *websocket;
-    int radio;
-    clientinfo(QWebSocket *ws, int r) : websocket(ws), radio(r) {};
+    quint64 id;
+    int radio;      // radio of a single radio client, -1 if tagged
+    quint32 radios; // subscribed radios, bit per radio
+    bool tagged;    // several radios, updates and actions carry "radio"
+    bool cbor;      // binary protocol, JSON otherwise
+    int deltaVersion[NRIG][kNDeltaObjects] = {}; // version client holds, 0 none
+    clientinfo() : id(0), radio(-1), radios(0), tagged(false), cbor(false) {};
+    clientinfo(quint64 id) : id(id), radio(-1), radios(0), tagged(false), cbor(false) {};
+  };
+  // last broadcast list of a delta object
+  struct deltaState {
+    int version = 0;
+    QJsonArray list;
+  };
+  deltaState radioDelta[NRIG][kNDeltaObjects];
+  static int deltaObject(const QJsonObject&);
+  static bool computeDelta(const QJsonArray&, const QJsonArray&, QJsonArray&);
+  void resyncClient(int, quint64);
+  void subscribeClient(quint64, quint32, bool, bool);
+  void radioClientsChanged(int);
+  static QString radioNumbers(quint32);
+  QHash<quint64, clientinfo> m_clients;
+  QVector<quint64> radioClients[NRIG]; // subscribers per radio
+  void serverListening(bool, int, bool);
+  void clientConnected(quint64, const QString&);
+  void processMessage(quint64, const QByteArray&);
+  // handler of a client {"action": ...} message, called with the radio
+  // the client is registered for
+  typedef void (*actionHandler)(MainWindow*, int, quint64, const QJsonObject&);
+  static const QHash<QString, actionHandler> &actionHandlers();
+  void socketDisconnected(quint64);
+  void slowClient(quint64, int, quint64);
+  void framesDropped(quint64, quint64);
+  void sendRadioWindowData(int, const QJsonObject&, quint64 = 0);
+
+  // updates queued during one event loop turn, one per object/method
+  struct pendingUpdate {
+    QString key;
+    QJsonObject object;
   };
-  QList<clientinfo> m_clients;
-  void onNewConnection();
-  void processMessage(const QByteArray&);
-  void socketDisconnected();
-  void sendRadioWindowData(int, const QJsonObject&, QWebSocket* = nullptr);
+  QVector<pendingUpdate> pendingBroadcast[NRIG];
+  QHash<quint64, QVector<pendingUpdate>> pendingDirect;
+  QHash<quint64, QVector<pendingUpdate>> pendingTagged; // all radios of a tagged client
+  bool flushScheduled = false;
+  void queueUpdate(QVector<pendingUpdate>&, const QJsonObject&);
+  void flushUpdates();
+  void sendFrame(int, const QVector<pendingUpdate>&, quint64 = 0);
+  void stampVersions(clientinfo&, QVector<pendingUpdate>&);
+  void sendTaggedFrames();
+  static QJsonObject tagRadio(int, const QJsonObject&);
+  QByteArray encodeFrame(const QVector<pendingUpdate>&, bool);
+  static QCborMap cborUpdate(const QJsonObject&);
+  void sendProtocolIds(int, quint64);
+
+  // everything a newly registered client of a radio is sent, shared by all
+  // registrations until the radio state changes
+  struct radioSnapshot {
+    bool valid = false;
+    quint32 generation = 0; // topology it was built from
+    QVector<pendingUpdate> updates;
+  };
+  radioSnapshot snapshot[NRIG];
+  quint64 snapshotClient = 0; // updates to it are captured, 0 none
+  void sendSnapshot(int, quint64);
+  void buildSnapshot(int, quint64);
+  void invalidateSnapshots();
+
   void restartWebSocketServer();
 
+  // logs, formatted and written to file in logThread. the last entries of
+  // each are kept in a model for the log tab
+  QThread *logThread;
+  Logger *logger;
+  LogModel *logModels[kNLogs];
+  QListView *logViews[kNLogs];
+  QLineEdit *logFilters[kNLogs];
+  void logEntries(const QVector<LogEntry>&);
+
+  // switching journal, switchCause is what is driving antennaChanged
+  Journal journal;
+  int switchCause = kCauseOther;
+
   // radio window functions
-  void radioNameSetText(int, QWebSocket* = nullptr);
-  void radioConnectionStatus(int, bool, QWebSocket* = nullptr);
-  void lbPttState(int, QWebSocket* = nullptr);
-  void lbHpfSetText(int, QWebSocket* = nullptr);
-  void lbBpfSetText(int, QWebSocket* = nullptr);
-  void lbGainSetText(int, QWebSocket* = nullptr);
-  void lbAuxSetText(int, QWebSocket* = nullptr);
-  void cbBandSetEnabled(int, QWebSocket* = nullptr);
-  void cbBandAddItems(int, QWebSocket* = nullptr);
-  void cbBandSetText(int, QString, QWebSocket* = nullptr);
+  void radioNameSetText(int, quint64 = 0);
+  void radioConnectionStatus(int, bool, quint64 = 0);
+  void lbPttState(int, quint64 = 0);
+  void lbHpfSetText(int, quint64 = 0);
+  void lbBpfSetText(int, quint64 = 0);
+  void lbGainSetText(int, quint64 = 0);
+  void lbAuxSetText(int, quint64 = 0);
+  void cbBandSetEnabled(int, quint64 = 0);
+  void cbBandAddItems(int, quint64 = 0);
+  void cbBandSetText(int, QString, quint64 = 0);
   void cbBandChanged(int, QString);
-  void cbGroupSetEnabled(int,bool, QWebSocket* = nullptr);
-  void cbGroupAddItems(int, QWebSocket* = nullptr);
-  void cbGroupSetText(int, QString, QWebSocket* = nullptr);
+  void cbGroupSetEnabled(int,bool, quint64 = 0);
+  void cbGroupAddItems(int, quint64 = 0);
+  void cbGroupSetText(int, QString, quint64 = 0);
   void cbGroupChanged(int, QString);
-  void pbScanStatus(int, bool, QWebSocket* = nullptr);
-  void pbScanSetEnabled(int,bool, QWebSocket* = nullptr);
-  void pbLockStatus(int, bool, QWebSocket* = nullptr);
-  void pbTrackSetEnabled(int,bool, QWebSocket* = nullptr);
-  void pbTrackStatus(int, bool, QWebSocket* = nullptr);
-  void cbLinkedSetEnabled(int,bool, QWebSocket* = nullptr);
-  void cbLinkedAddItems(int, QWebSocket* = nullptr);
-  void cbLinkedSetIndex(int, QWebSocket* = nullptr);
-  void cbScanDelaySetEnabled(int,bool, QWebSocket* = nullptr);
-  void cbScanDelaySetIndex(int, QWebSocket* = nullptr);
-  void cbScanDelayAddItems(int, QWebSocket* = nullptr);
-  void pbScanEnabledStatus(int, QWebSocket* = nullptr);
-  void bearingLabelText(int, QWebSocket* = nullptr);
-  void frameSetEnabled(int,bool, QWebSocket* = nullptr);
+  void pbScanStatus(int, bool, quint64 = 0);
+  void pbScanSetEnabled(int,bool, quint64 = 0);
+  void pbLockStatus(int, bool, quint64 = 0);
+  void pbTrackSetEnabled(int,bool, quint64 = 0);
+  void pbTrackStatus(int, bool, quint64 = 0);
+  void cbLinkedSetEnabled(int,bool, quint64 = 0);
+  void cbLinkedAddItems(int, quint64 = 0);
+  void cbLinkedSetIndex(int, quint64 = 0);
+  void cbScanDelaySetEnabled(int,bool, quint64 = 0);
+  void cbScanDelaySetIndex(int, quint64 = 0);
+  void cbScanDelayAddItems(int, quint64 = 0);
+  void pbScanEnabledStatus(int, quint64 = 0);
+  void bearingLabelText(int, quint64 = 0);
+  void frameSetEnabled(int,bool, quint64 = 0);
 
   QCheckBox *radioEnableCheckBox[NRIG];
   QLineEdit *radioNameLineEdit[NRIG];
@@ -131,6 +236,7 @@ private:
   QLabel *clientsLabel[NRIG];
 
   RigSerial     *cat[NRIG];
+  RadioConfig   radioConfig[NRIG];
 
   void initDatabase();
   void resetDatabase();
@@ -138,8 +244,13 @@ private:
   void populateSerialPortComboBox(QComboBox*);//, QString);
   void populateBaudRateComboBox(QComboBox*);//, QString);
   void rs485Connection();
-  void rs485RcvdData();
+  void rs485Opened(bool, const QString &);
+  void rs485Closed(const QString &);
+  void rs485Sent(const QByteArray &);
+  void rs485SendFailed(const QByteArray &, const QString &);
+  void rs485RcvdData(const QString &);
   void rs485SendData(QByteArray);
+  void loadRadioConfig();
   void setRadioFormFromSettings();
   void rejectSettings();
   void writeSettings();
@@ -155,7 +266,9 @@ private:
   void radioConnection(int);
 
   void about();
-  void timeoutMainTimer();
+  void updateRadioStates();
+  bool updateRadioState(int);
+  void timeoutScanTimer(int);
   void addBand();
   void saveBand();
   void removeBand();
@@ -218,6 +331,7 @@ private:
   int currentGroup[NRIG];
   int currentBearing[NRIG];
   int currentFreq[NRIG];
+  Topology::BandHint bandHint[NRIG];
   bool currentPtt[NRIG];
   int currentTrackedRadio[NRIG];
   int currentScanDelay[NRIG];
@@ -226,7 +340,8 @@ private:
   bool trackingState[NRIG];
   bool lockState[NRIG];
   bool radioConnected[NRIG];
-  int scanCount[NRIG];
+  bool scanPaused[NRIG];
+  RigState catState[NRIG];
   int prevGroupTrack[NRIG];
   QString prevGroupLabel[NRIG];
   int prevAntennaTrack[NRIG];
@@ -234,21 +349,25 @@ private:
 
   int getAux(int);
 
-  void createAntennaButtons(int, QWebSocket* = nullptr);
+  void createAntennaButtons(int, quint64 = 0);
   void antennaButtonClicked(int, int);
-  void updateAntennaButtonsSelection(int, QWebSocket* = nullptr);
+  void updateAntennaButtonsSelection(int, quint64 = 0);
 
-  void updateGraphicsEllipse(int, QWebSocket* = nullptr);
-  void updateGraphicsLines(int, QWebSocket* = nullptr);
-  void updateGraphicsLabels(int, QWebSocket* = nullptr);
+  void updateGraphicsEllipse(int, quint64 = 0);
+  void updateGraphicsLines(int, quint64 = 0);
+  void updateGraphicsLabels(int, quint64 = 0);
 
-  void setLayoutIndex(int, int, QWebSocket* = nullptr);
+  void setLayoutIndex(int, int, quint64 = 0);
 
   void bearingChangedMouse(int,int);
 
 //public slots:
 
-//signals:
+signals:
+  void wsListen(int);
+  void wsSend(quint64, const QByteArray&, const QStringList&, bool);
+  void rs485Open(const QString &);
+  void rs485Close();
 
 //private slots:
 
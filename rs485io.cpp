@@ -0,0 +1,249 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#include "rs485io.hpp"
+
+Rs485IO::Rs485IO(Logger *logger)
+{
+  ring = new Slot[kRs485RingSize];
+  for (int i=0; i<kRs485RingSize; ++i) {
+    ring[i].seq.store(i, std::memory_order_relaxed);
+  }
+  head = 0;
+  tail = 0;
+  wakePending = false;
+  portOpen = false;
+  nDropped = 0;
+  nSuperseded = 0;
+  reportedSuperseded = 0;
+  offset = 0;
+  outstanding = 0;
+  this->logger = logger;
+  port = new QSerialPort(this); // moved to the I/O thread along with this
+  connect(port, &QSerialPort::bytesWritten, this, &Rs485IO::onBytesWritten);
+  connect(port, &QSerialPort::readyRead, this, &Rs485IO::onReadyRead);
+  connect(port, &QSerialPort::errorOccurred, this, &Rs485IO::onError);
+  writeTimer = new QTimer(this);
+  writeTimer->setSingleShot(true);
+  writeTimer->setInterval(kRs485WriteTimeout);
+  connect(writeTimer, &QTimer::timeout, this, &Rs485IO::onWriteTimeout);
+}
+
+Rs485IO::~Rs485IO()
+{
+  if (port->isOpen()) port->close();
+  delete[] ring;
+}
+
+/*! open port name, 38400 8N1, replies with opened()
+*/
+void Rs485IO::open(const QString &name)
+{
+  if (port->isOpen()) closePort(QString());
+  port->setPortName(name);
+  port->setBaudRate(QSerialPort::Baud38400);
+  port->setFlowControl(QSerialPort::NoFlowControl);
+  port->setParity(QSerialPort::NoParity);
+  port->setDataBits(QSerialPort::Data8);
+  port->setStopBits(QSerialPort::OneStop);
+  if (!port->open(QIODevice::ReadWrite)) {
+    emit(opened(false, name));
+    return;
+  }
+  port->setRequestToSend(false); // RTS
+  port->setDataTerminalReady(false); // DTS
+  portOpen.store(true, std::memory_order_release);
+  emit(opened(true, name));
+}
+
+void Rs485IO::close()
+{
+  closePort(QString());
+}
+
+/*! close the port and forget anything not yet sent, replies with
+  closed(), error empty if asked to
+*/
+void Rs485IO::closePort(const QString &error)
+{
+  portOpen.store(false, std::memory_order_release);
+  writeTimer->stop();
+  if (port->isOpen()) port->close();
+  drain(); // empties the ring, nothing is written while closed
+  queue.clear();
+  current.clear();
+  offset = 0;
+  outstanding = 0;
+  emit(closed(error));
+}
+
+/*! queue a command, not done if the port is closed or the ring is full
+*/
+Rs485IO::SendResult Rs485IO::send(const QByteArray &data)
+{
+  if (!isOpen()) return Closed;
+  quint64 pos = head.load(std::memory_order_relaxed);
+  Slot *slot;
+  for (;;) {
+    slot = &ring[pos & (kRs485RingSize - 1)];
+    quint64 seq = slot->seq.load(std::memory_order_acquire);
+    qint64 diff = qint64(seq - pos);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) { // full, I/O thread is a whole ring behind
+      nDropped.fetch_add(1, std::memory_order_relaxed);
+      return QueueFull;
+    } else {
+      pos = head.load(std::memory_order_relaxed);
+    }
+  }
+  slot->data = data;
+  slot->seq.store(pos + 1, std::memory_order_release);
+  // one wake up per batch, cleared by drain before it reads the ring
+  if (!wakePending.exchange(true, std::memory_order_acq_rel)) {
+    QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+  }
+  return Queued;
+}
+
+/*! move commands from the ring to the queue and get writing
+*/
+void Rs485IO::drain()
+{
+  wakePending.store(false, std::memory_order_release);
+  for (;;) {
+    Slot *slot = &ring[tail & (kRs485RingSize - 1)];
+    if (slot->seq.load(std::memory_order_acquire) != tail + 1) break;
+    QByteArray data = std::move(slot->data);
+    slot->data = QByteArray();
+    slot->seq.store(tail + kRs485RingSize, std::memory_order_release);
+    ++tail;
+    if (port->isOpen()) enqueue(data);
+  }
+  writeNext();
+}
+
+/*! append to the queue, dropping a waiting command this one supersedes
+*/
+void Rs485IO::enqueue(const QByteArray &data)
+{
+  Command command{ data, supersedeKey(data) };
+  if (!command.key.isEmpty()) {
+    for (auto q = queue.begin(); q != queue.end(); ++q) {
+      if (q->key == command.key) { // at most one waiting per key
+        queue.erase(q);
+        nSuperseded.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+    }
+  }
+  queue << command;
+}
+
+/*! "DATA 0 <radio>" / "AUX 0 <radio>" of a DATA or AUX command, empty for
+  anything else
+*/
+QByteArray Rs485IO::supersedeKey(const QByteArray &data)
+{
+  if (!data.startsWith("DATA ") && !data.startsWith("AUX ")) return QByteArray();
+  int end = -1;
+  for (int i=0; i<3; ++i) {
+    end = data.indexOf(' ', end + 1);
+    if (end < 0) return QByteArray();
+  }
+  return data.left(end);
+}
+
+/*! start on the next command if the line is free, or continue a partial
+  write
+*/
+void Rs485IO::writeNext()
+{
+  if (!port->isOpen()) return;
+  if (current.isEmpty()) {
+    if (queue.isEmpty()) {
+      // line idle, report what was dropped during the burst
+      quint64 superseded = nSuperseded.load(std::memory_order_relaxed);
+      if (superseded != reportedSuperseded) {
+        logger->log(kLogSerial, QString("%1 superseded commands dropped (%2 total)")
+                                 .arg(superseded - reportedSuperseded)
+                                 .arg(superseded));
+        reportedSuperseded = superseded;
+      }
+      return;
+    }
+    current = queue.takeFirst().data;
+    offset = 0;
+    outstanding = 0;
+  }
+  if (offset < current.size()) {
+    qint64 n = port->write(current.constData() + offset, current.size() - offset);
+    if (n < 0) {
+      fail(port->errorString());
+      return;
+    }
+    offset += n;
+    outstanding += n;
+    writeTimer->start();
+  }
+}
+
+void Rs485IO::onBytesWritten(qint64 bytes)
+{
+  outstanding -= bytes;
+  if (current.isEmpty()) return;
+  writeTimer->start(); // progress
+  if (offset < current.size()) { // rest of a partial write
+    writeNext();
+    return;
+  }
+  if (outstanding > 0) return;
+  writeTimer->stop();
+  logger->logFrame(kLogSerial, current, false);
+  emit(sent(current));
+  current.clear();
+  writeNext();
+}
+
+/*! give up on the current command, drop what the port still holds of it
+  and carry on with the next
+*/
+void Rs485IO::fail(const QString &error)
+{
+  writeTimer->stop();
+  if (port->isOpen()) port->clear(QSerialPort::Output);
+  logger->log(kLogSerial, QString("Send failed (%1): %2").arg(error, QString::fromUtf8(current).simplified()));
+  emit(sendFailed(current, error));
+  current.clear();
+  offset = 0;
+  outstanding = 0;
+  writeNext();
+}
+
+void Rs485IO::onWriteTimeout()
+{
+  if (!current.isEmpty()) fail("write timeout");
+}
+
+void Rs485IO::onReadyRead()
+{
+  while (port->canReadLine()) {
+    emit(received(QString::fromUtf8(port->readLine())));
+  }
+}
+
+void Rs485IO::onError(QSerialPort::SerialPortError error)
+{
+  if (error == QSerialPort::NoError) return;
+  if (error == QSerialPort::ResourceError) { // device gone
+    QString text = port->errorString();
+    port->clearError();
+    closePort(text);
+  } else if (error == QSerialPort::WriteError || error == QSerialPort::TimeoutError) {
+    QString text = port->errorString();
+    port->clearError();
+    if (!current.isEmpty()) fail(text);
+  }
+}
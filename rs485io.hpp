@@ -0,0 +1,92 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#pragma once
+
+#include "defines.hpp"
+#include "logger.hpp"
+
+/*!
+   RS485 port, owned by its own QThread.
+
+   send() may be called from any thread, it only claims a slot in a fixed
+   size ring (multi-producer, single consumer, no locks) and wakes the I/O
+   thread; it never touches the port. The I/O thread moves commands into
+   its queue and writes them one at a time, a command is complete once
+   all its bytes were taken by the driver (bytesWritten), partial writes
+   are continued from there. Completion and failure are reported through
+   queued signals, sent commands are logged from the I/O thread.
+
+   DATA and AUX commands carry the whole state of one radio, a waiting one
+   is dropped when a newer one for the same radio is queued (latest wins).
+   The newer one goes to the end of the queue so commands still leave in
+   the order they were sent.
+ */
+class Rs485IO : public QObject
+{
+Q_OBJECT
+
+public:
+    enum SendResult { Queued, Closed, QueueFull };
+
+    Rs485IO(Logger *);
+    ~Rs485IO();
+    SendResult send(const QByteArray &);
+    bool isOpen() const { return portOpen.load(std::memory_order_acquire); }
+    quint64 droppedCommands() const { return nDropped.load(std::memory_order_relaxed); }
+    quint64 supersededCommands() const { return nSuperseded.load(std::memory_order_relaxed); }
+
+signals:
+    void opened(bool, const QString &);
+    void closed(const QString &);
+    void sent(const QByteArray &);
+    void sendFailed(const QByteArray &, const QString &);
+    void received(const QString &);
+
+public slots:
+    void open(const QString &);
+    void close();
+
+private slots:
+    void drain();
+    void onBytesWritten(qint64);
+    void onReadyRead();
+    void onError(QSerialPort::SerialPortError);
+    void onWriteTimeout();
+
+private:
+    struct Slot {
+        std::atomic<quint64> seq;
+        QByteArray data;
+    };
+
+    struct Command {
+        QByteArray data;
+        QByteArray key;  // "DATA 0 <radio>" or "AUX 0 <radio>", empty never superseded
+    };
+
+    void enqueue(const QByteArray &);
+    void writeNext();
+    static QByteArray supersedeKey(const QByteArray &);
+    void fail(const QString &);
+    void closePort(const QString &);
+
+    Slot *ring;
+    std::atomic<quint64> head;       // next slot to claim, producers
+    quint64 tail;                    // next slot to read, I/O thread only
+    std::atomic<bool> wakePending;   // drain() queued, not yet started
+    std::atomic<bool> portOpen;
+    std::atomic<quint64> nDropped;   // ring full
+    std::atomic<quint64> nSuperseded; // replaced by a newer command while queued
+    quint64 reportedSuperseded;
+
+    QSerialPort *port;
+    QList<Command> queue;     // waiting for the line
+    QByteArray current;       // being written, empty none
+    qint64 offset;            // bytes of current given to the port
+    qint64 outstanding;       // given to the port, not yet written
+    QTimer *writeTimer;
+    Logger *logger;
+};
@@ -23,6 +23,11 @@ Modifications by NO3M for softRX
 */
 
 #include "serial.hpp"
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // need to define this internal hamlib function
 extern "C" HAMLIB_EXPORT(int) write_block(hamlib_port_t *p, const char *txbuffer, size_t count);
@@ -30,6 +35,13 @@ extern "C" HAMLIB_EXPORT(int) write_block(hamlib_port_t *p, const char *txbuffer
 // initialize statics
 QList<hamlibmfg> RigSerial::mfg;
 QList<QByteArray> RigSerial::mfgName;
+const RigSerial::RigctldCmdInfo RigSerial::rigctldCmds[RigSerial::kRigctldNCmds] = {
+  { "get_freq:", ";\\get_freq\n" },
+  { "get_ptt:", ";\\get_ptt\n" },
+  { "get_mode:", ";\\get_mode\n" },
+  { "get_vfo:", ";\\get_vfo\n" },
+  { "get_split_vfo:", ";\\get_split_vfo\n" }
+};
 
 /*! comparison for radio manufacturer class. Compare by name
 */
@@ -70,11 +82,30 @@ RigSerial::RigSerial(int nr)
   settings=nullptr;
   rig=nullptr;
   socket=nullptr;
-  radioOK=false;
-  rigFreq=0;
-  rigPtt=false;
   model=1;
-  lock.unlock();
+  activity=false;
+  transceive=false;
+  pollFloor=s_radioPollFloor_def;
+  pollCeiling=s_radioPollTime_def;
+  pollInterval=pollFloor;
+  nPollCmds=0;
+  pollDepth=s_rigctldDepth_def;
+  pollTimeout=s_rigctldTimeout_def;
+  clock.start();
+  resetRxSocket();
+  connect(&timer, &QTimer::timeout, this, &RigSerial::timeoutTimer);
+  trnPipe[0] = trnPipe[1] = -1;
+  trnNotifier = nullptr;
+#ifdef Q_OS_UNIX
+  if (pipe(trnPipe) == 0) {
+    for (int fd : trnPipe) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+  } else {
+    trnPipe[0] = trnPipe[1] = -1;
+  }
+#endif
 }
 
 /*! static function passed to rig_list_foreach
@@ -191,6 +222,11 @@ RigSerial::~RigSerial()
   rig_cleanup(rig);
   if (socket) delete socket;
   if (settings) delete settings;
+#ifdef Q_OS_UNIX
+  for (int fd : trnPipe) {
+    if (fd >= 0) ::close(fd);
+  }
+#endif
 }
 
 
@@ -200,10 +236,19 @@ Called when thread started
 void RigSerial::run()
 {
   if (!settings) settings=new QSettings("softrx", "settings");
+  if (!trnNotifier && trnPipe[0] >= 0) { // created in the radio thread
+    trnNotifier = new QSocketNotifier(trnPipe[0], QSocketNotifier::Read, this);
+    connect(trnNotifier, &QSocketNotifier::activated, this, &RigSerial::trnCheck);
+  }
   openRig();
   openSocket();
-  connect(&timer, &QTimer::timeout, this, &RigSerial::timeoutTimer);
-  timer.start(settings->value(s_radioPollTime[nrig],s_radioPollTime_def).toInt());
+  if (trnNotifier) trnNotifier->setEnabled(transceive);
+  pollFloor = qMax(kRadioPollMin, settings->value(s_radioPollFloor[nrig],s_radioPollFloor_def).toInt());
+  pollCeiling = qMax(pollFloor, settings->value(s_radioPollTime[nrig],s_radioPollTime_def).toInt());
+  if (transceive) pollFloor = pollCeiling;
+  pollInterval = pollFloor;
+  activity = false;
+  timer.start(pollInterval);
   //qDebug() << nrig << " " << timer.thread();
 }
 
@@ -212,6 +257,7 @@ void RigSerial::run()
 void RigSerial::stopSerial()
 {
   timer.stop();
+  if (trnNotifier) trnNotifier->setEnabled(false);
 }
 
 void RigSerial::timeoutTimer()
@@ -220,54 +266,152 @@ void RigSerial::timeoutTimer()
   if (settings->value(s_rigctld[nrig],s_rigctld_def).toBool() &&
                                    socket->isOpen()) {
 
-    socket->write(";\\get_freq\n");
-    socket->write(";\\get_ptt\n");
+    // bounded pipeline: a poll is skipped rather than queued behind
+    // replies that have not come back yet
+    expirePending();
+    if (inFlight >= pollDepth) {
+      statsMutex.lock();
+      stats.skipped++;
+      statsMutex.unlock();
+      return;
+    }
+    socket->write(pollBatch);
+    qint64 now = clock.elapsed();
+    for (int i = 0; i < nPollCmds; i++) {
+      addPending(pollCmds[i], now, i == nPollCmds - 1);
+    }
 
   } else {
     // using hamlib over serial port
     // poll frequency and ptt status from radio
-    if (radioOK) {
+    if (state.ok) {
       freq_t freq;
       int status = rig_get_freq(rig, RIG_VFO_CURR, &freq);
       if (status == RIG_OK) {
         double ff = Hz(freq);
-        if (ff != 0.0) rigFreq = ff;
+        if (ff != 0.0) setRigFreq(ff);
       }
       ptt_t ptt;
       status = rig_get_ptt(rig, RIG_VFO_CURR, &ptt);
       if (status == RIG_OK) {
-        rigPtt = (bool)ptt;
+        setRigPtt((bool)ptt);
       }
     }
   }
+  adaptPollRate();
+}
+
+/*! poll at the floor rate while the radio is changing, back off
+  gradually to the ceiling while idle
+*/
+void RigSerial::adaptPollRate()
+{
+  int next;
+  if (activity) {
+    next = pollFloor;
+  } else {
+    next = qMin(pollCeiling, qMax(pollInterval + 1, pollInterval * 3 / 2)); // grows from any floor
+  }
+  activity = false;
+  if (next != pollInterval) {
+    pollInterval = next;
+    timer.start(pollInterval);
+  }
+}
+
+/*! consistent snapshot of frequency, ptt and connection state
+
+  lock free, safe to call from any thread. retries only if the radio
+  thread published a change while reading
+*/
+RigState RigSerial::rigState() const
+{
+  RigState r;
+  quint32 s0, s1;
+  do {
+    s0 = stateSeq.load(std::memory_order_acquire);
+    r.freq = sharedFreq.load(std::memory_order_relaxed);
+    r.ptt = sharedPtt.load(std::memory_order_relaxed);
+    r.ok = sharedOk.load(std::memory_order_relaxed);
+    r.mode = sharedMode.load(std::memory_order_relaxed);
+    r.vfo = sharedVfo.load(std::memory_order_relaxed);
+    r.split = sharedSplit.load(std::memory_order_relaxed);
+    r.timestamp = sharedTimestamp.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    s1 = stateSeq.load(std::memory_order_relaxed);
+  } while ((s0 & 1) || s0 != s1);
+  return(r);
 }
 
 /*! returns true if radio opened successfully
 */
-bool RigSerial::radioOpen()
+bool RigSerial::radioOpen() const
 {
-  lock.lockForRead();
-  bool b = radioOK;
-  lock.unlock();
-  return(b);
+  return(rigState().ok);
 }
 
 /*! returns current radio frequency in Hz
 */
-double RigSerial::getRigFreq()
+double RigSerial::getRigFreq() const
+{
+  return(rigState().freq);
+}
+
+bool RigSerial::getRigPtt() const
+{
+  return(rigState().ptt);
+}
+
+/*! copy state to the seqlock, single writer (the radio thread, or the
+  main thread once the radio thread is stopped)
+*/
+void RigSerial::publishState()
 {
-  lock.lockForRead();
-  double f = rigFreq;
-  lock.unlock();
-  return(f);
+  state.timestamp = QDateTime::currentMSecsSinceEpoch();
+  quint32 s = stateSeq.load(std::memory_order_relaxed);
+  stateSeq.store(s + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  sharedFreq.store(state.freq, std::memory_order_relaxed);
+  sharedPtt.store(state.ptt, std::memory_order_relaxed);
+  sharedOk.store(state.ok, std::memory_order_relaxed);
+  sharedMode.store(state.mode, std::memory_order_relaxed);
+  sharedVfo.store(state.vfo, std::memory_order_relaxed);
+  sharedSplit.store(state.split, std::memory_order_relaxed);
+  sharedTimestamp.store(state.timestamp, std::memory_order_relaxed);
+  stateSeq.store(s + 2, std::memory_order_release);
 }
 
-bool RigSerial::getRigPtt()
+/*! update frequency, signal only on change
+*/
+void RigSerial::setRigFreq(double f)
 {
-  lock.lockForRead();
-  bool p = rigPtt;
-  lock.unlock();
-  return(p);
+  if (state.freq == f) return;
+  state.freq = f;
+  activity = true;
+  publishState();
+  emit(frequencyChanged(f));
+}
+
+/*! update ptt, signal only on change
+*/
+void RigSerial::setRigPtt(bool p)
+{
+  if (state.ptt == p) return;
+  state.ptt = p;
+  activity = true;
+  publishState();
+  emit(pttChanged(p));
+}
+
+/*! update radio connection state, signal only on change
+*/
+void RigSerial::setRadioOK(bool b)
+{
+  if (state.ok == b) return;
+  state.ok = b;
+  activity = true;
+  publishState();
+  emit(connectionChanged(b));
 }
 
 void RigSerial::closeSocket()
@@ -276,6 +420,96 @@ void RigSerial::closeSocket()
     if (socket->isOpen()) socket->close();
     disconnect(socket,nullptr,nullptr,nullptr);
   }
+  resetRxSocket();
+}
+
+/*! clear rigctld receive buffer and outstanding commands
+*/
+void RigSerial::resetRxSocket()
+{
+  rxStart = 0;
+  rxCount = 0;
+  rxScanned = 0;
+  pendingHead = 0;
+  pendingCount = 0;
+  inFlight = 0;
+}
+
+/*! remember a command written to rigctld, the oldest is forgotten if
+  too many are outstanding
+*/
+void RigSerial::addPending(int cmd, qint64 sent, bool last)
+{
+  if (pendingCount == kRigctldMaxPending) {
+    removePending(1);
+  }
+  Pending &p = pending[(pendingHead + pendingCount) % kRigctldMaxPending];
+  p.cmd = cmd;
+  p.sent = sent;
+  p.last = last;
+  pendingCount++;
+  if (last) inFlight++;
+}
+
+/*! drop the n oldest outstanding commands
+*/
+void RigSerial::removePending(int n)
+{
+  for (int i = 0; i < n && pendingCount; i++) {
+    if (pending[pendingHead].last) inFlight--;
+    pendingHead = (pendingHead + 1) % kRigctldMaxPending;
+    pendingCount--;
+  }
+}
+
+/*! match a reply to the oldest outstanding command of the same kind.
+  rigctld answers in order, so older commands ahead of it were lost and
+  are dropped too. returns false for a reply nothing was waiting for
+*/
+bool RigSerial::takePending(int cmd)
+{
+  for (int i = 0; i < pendingCount; i++) {
+    const Pending &p = pending[(pendingHead + i) % kRigctldMaxPending];
+    if (p.cmd == cmd) {
+      int rtt = clock.elapsed() - p.sent;
+      statsMutex.lock();
+      stats.lastRtt = rtt;
+      if (!stats.replies || rtt < stats.minRtt) stats.minRtt = rtt;
+      if (rtt > stats.maxRtt) stats.maxRtt = rtt;
+      stats.avgRtt = stats.replies ? stats.avgRtt + (rtt - stats.avgRtt) / 8.0 : rtt;
+      stats.replies++;
+      statsMutex.unlock();
+      removePending(i + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*! forget commands that got no reply within the timeout
+*/
+void RigSerial::expirePending()
+{
+  qint64 now = clock.elapsed();
+  int n = 0;
+  while (n < pendingCount &&
+         now - pending[(pendingHead + n) % kRigctldMaxPending].sent > pollTimeout) {
+    n++;
+  }
+  if (n) {
+    removePending(n);
+    statsMutex.lock();
+    stats.timeouts += n;
+    statsMutex.unlock();
+  }
+}
+
+/*! rigctld round trip and pipeline counters, safe to call from any thread
+*/
+RigctldStats RigSerial::rigctldStats() const
+{
+  QMutexLocker locker(&statsMutex);
+  return(stats);
 }
 
 /*! initialize TcpSocket for rigctld
@@ -284,9 +518,32 @@ void RigSerial::openSocket()
 {
   closeSocket();
   if (settings->value(s_rigctld[nrig],s_rigctld_def).toBool()) {
-    radioOK=true;
+    setRadioOK(true);
     if (!socket) socket=new QTcpSocket();
 
+    // freq and ptt are always polled, extra commands are added to the
+    // same write
+    nPollCmds = 0;
+    pollCmds[nPollCmds++] = kGetFreq;
+    pollCmds[nPollCmds++] = kGetPtt;
+    const QStringList extra = settings->value(s_rigctldExtraCmds[nrig],s_rigctldExtraCmds_def).toString()
+                              .simplified().split(' ');
+    for (int i = kGetMode; i < kRigctldNCmds; i++) {
+      QString name = QString(rigctldCmds[i].reply);
+      name.chop(1);
+      if (extra.contains(name)) pollCmds[nPollCmds++] = i;
+    }
+    pollBatch.clear();
+    for (int i = 0; i < nPollCmds; i++) {
+      pollBatch.append(rigctldCmds[pollCmds[i]].request);
+    }
+    pollDepth = qBound(1, settings->value(s_rigctldDepth[nrig],s_rigctldDepth_def).toInt(),
+                       kRigctldMaxPending / nPollCmds);
+    pollTimeout = qMax(1, settings->value(s_rigctldTimeout[nrig],s_rigctldTimeout_def).toInt());
+    statsMutex.lock();
+    stats = RigctldStats();
+    statsMutex.unlock();
+
     // QHostAddress doesn't understand "localhost"
     if (settings->value(s_rigctldIp[nrig],s_rigctldIp_def).toString().simplified()=="localhost") {
       socket->connectToHost(QHostAddress::LocalHost,
@@ -311,7 +568,8 @@ void RigSerial::openSocket()
   */
   void RigSerial::openRig()
   {
-    radioOK      = false;
+    setRadioOK(false);
+    transceive = false;
     model=settings->value(s_radioModel[nrig],s_radioModel_def).toInt();
     if (rig) {
       rig_close(rig);
@@ -322,31 +580,124 @@ void RigSerial::openSocket()
     rig_set_conf(rig,t,settings->value(s_radioSerialPort[nrig],s_radioSerialPort_def).toString().toLatin1().data());
     rig->state.rigport.parm.serial.rate=settings->value(s_radioBaudRate[nrig],s_radioBaudRate_def).toInt();
     //t = rig_token_lookup(rig,"ptt_type");
-    rigFreq = 0;
+    setRigFreq(0);
     int r = rig_open(rig);
     if (model == RIG_MODEL_DUMMY) {
-      rig_set_freq(rig, RIG_VFO_A, rigFreq);
+      rig_set_freq(rig, RIG_VFO_A, 0);
       rig_set_vfo(rig, RIG_VFO_A);
     }
     if (r == RIG_OK) {
-      radioOK = true;
+      setRadioOK(true);
+      // transceive: radio reports changes itself (Kenwood AI, Icom CI-V
+      // transceive...), not used with rigctld. needs the wake up pipe,
+      // Unix only, as is Hamlib's SIGIO based transceive
+      if (settings->value(s_radioTransceive[nrig],s_radioTransceive_def).toBool() &&
+          !settings->value(s_rigctld[nrig],s_rigctld_def).toBool()) {
+        if (trnPipe[1] < 0) {
+          emit(radioError("ERROR: radio "+QString::number(nrig+1)+" transceive not available, polling"));
+          return;
+        }
+        rig_set_freq_callback(rig, trnFreqCallback, this);
+        rig_set_ptt_callback(rig, trnPttCallback, this);
+        if (rig->caps->transceive != RIG_TRN_OFF && rig_set_trn(rig, RIG_TRN_RIG) == RIG_OK) {
+          transceive = true;
+        } else {
+          rig_set_freq_callback(rig, nullptr, nullptr);
+          rig_set_ptt_callback(rig, nullptr, nullptr);
+          emit(radioError("ERROR: radio "+QString::number(nrig+1)+" does not support transceive, polling"));
+        }
+      }
     } else {
       emit(radioError("ERROR: radio "+QString::number(nrig+1)+" could not be opened"));
-      radioOK = false;
+      setRadioOK(false);
       rig_close(rig);
     }
   }
 
+  /*! hamlib transceive callbacks
+  *
+  * these are not called from the radio thread, and depending on the
+  * Hamlib version may run inside its SIGIO handler (add_trn_rig), so
+  * nothing here may allocate or lock: the value is stored in lock free
+  * atomics, and write() on the pipe (async-signal-safe) wakes trnCheck in
+  * the radio thread. only the first of several events before it runs
+  * writes
+  */
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_BOOL_LOCK_FREE == 2,
+                "transceive callbacks need lock free atomics");
+
+  int RigSerial::trnFreqCallback(RIG *rig, vfo_t vfo, freq_t freq, rig_ptr_t arg)
+  {
+    Q_UNUSED(rig)
+    Q_UNUSED(vfo)
+    RigSerial *serial = static_cast<RigSerial *>(arg);
+    serial->trnFreqValue.store(qRound64(Hz(freq)), std::memory_order_relaxed);
+    serial->trnWake(serial->trnFlags.fetch_or(kTrnFreq, std::memory_order_release));
+    return RIG_OK;
+  }
+
+  int RigSerial::trnPttCallback(RIG *rig, vfo_t vfo, ptt_t ptt, rig_ptr_t arg)
+  {
+    Q_UNUSED(rig)
+    Q_UNUSED(vfo)
+    RigSerial *serial = static_cast<RigSerial *>(arg);
+    serial->trnPttValue.store(ptt != RIG_PTT_OFF, std::memory_order_relaxed);
+    serial->trnWake(serial->trnFlags.fetch_or(kTrnPtt, std::memory_order_release));
+    return RIG_OK;
+  }
+
+  /*! wake the radio thread if no event was waiting (prev flags 0), may
+    run in a signal handler
+  */
+  void RigSerial::trnWake(int prev)
+  {
+#ifdef Q_OS_UNIX
+    if (!prev) {
+      int saved = errno;
+      char c = 0;
+      ssize_t n = ::write(trnPipe[1], &c, 1); // full pipe: a wake up is pending anyway
+      Q_UNUSED(n)
+      errno = saved;
+    }
+#else
+    Q_UNUSED(prev)
+#endif
+  }
+
+  /*! take values left by the transceive callbacks, in the radio thread
+    when the pipe is readable. the pipe is emptied before the flags are
+    taken so an event after that wakes it again
+  */
+  void RigSerial::trnCheck()
+  {
+#ifdef Q_OS_UNIX
+    char buf[64];
+    while (::read(trnPipe[0], buf, sizeof(buf)) > 0) {}
+#endif
+    int flags = trnFlags.exchange(0, std::memory_order_acquire);
+    if (flags & kTrnFreq) {
+      qint64 f = trnFreqValue.load(std::memory_order_relaxed);
+      if (f != 0) setRigFreq(f);
+    }
+    if (flags & kTrnPtt) {
+      setRigPtt(trnPttValue.load(std::memory_order_relaxed));
+    }
+  }
+
   /*! shut down radio interface
   */
   void RigSerial::closeRig()
   {
+    if (transceive) {
+      rig_set_trn(rig, RIG_TRN_OFF);
+      transceive = false;
+    }
     rig_close(rig);
     rig_cleanup(rig);
     rig=nullptr;
-    radioOK = false;
-    rigFreq = 0;
-    rigPtt = false;
+    setRadioOK(false);
+    setRigFreq(0);
+    setRigPtt(false);
   }
 
   /*! send a raw byte string to the radio: careful, there is no checking here!
@@ -386,48 +737,134 @@ void RigSerial::openSocket()
 
   /*!
   * \brief RigSerial::rxSocket
-  * \param nrig
   *
-  * Parse data coming from rigctld
+  * Read data coming from rigctld into the receive ring. Replies can be
+  * split over several reads or several can arrive in one read, so only
+  * complete records are parsed
   */
   void RigSerial::rxSocket()
   {
-    const QByteArray cmdNames[] = { "get_freq:",
-    "get_ptt:" };
-    const int nCmdNames=2;
-
-    radioOK=true;
-    lock.lockForWrite();
+    setRadioOK(true);
     while (socket->bytesAvailable()) {
-      QByteArray data=socket->readAll();
-      QList<QByteArray> cmdList=data.split(';');
-      bool ok;
-      double f;
-      bool p;
-      for (int i = 0; i < nCmdNames; i++) {
-        if (cmdList.at(0)==cmdNames[i]) {
-          switch (i) {
-            case 0: // "get_freq:;Frequency: 28009360;RPRT 0"
-            cmdList[1].remove(0,10);
-            f=cmdList[1].toDouble(&ok);
-            if (ok) rigFreq=f;
-            break;
-            case 1: // "get_ptt:;PTT: 0;RPRT 0"
-            cmdList[1].remove(0,4);
-            p=cmdList[1].toInt(&ok);
-            if (ok) rigPtt=(bool)p;
-            break;
-          }
+      if (rxCount == kRigctldRxSize) {
+        // full without a record end, nothing sensible left to parse
+        rxStart = 0;
+        rxCount = 0;
+        rxScanned = 0;
+      }
+      // largest contiguous free space
+      int end = (rxStart + rxCount) % kRigctldRxSize;
+      int room = (end < rxStart) ? rxStart - end : kRigctldRxSize - end;
+      qint64 n = socket->read(rxRing + end, room);
+      if (n <= 0) break;
+      rxCount += n;
+      parseRxSocket();
+    }
+    // replies come in between polls, speed up right away on a change
+    if (activity) adaptPollRate();
+  }
+
+  /*! split complete records out of the receive ring
+  */
+  void RigSerial::parseRxSocket()
+  {
+    while (rxScanned < rxCount) {
+      char c = rxRing[(rxStart + rxScanned) % kRigctldRxSize];
+      rxScanned++;
+      if (c != '\n') continue;
+
+      int len = rxScanned - 1;
+      if (len < kRigctldLineSize) { // longer ones are garbage, skip
+        for (int i = 0; i < len; i++) {
+          rxLine[i] = rxRing[(rxStart + i) % kRigctldRxSize];
         }
+        rxLine[len] = '\0';
+        parseReply(rxLine, len);
+      }
+      rxStart = (rxStart + rxScanned) % kRigctldRxSize;
+      rxCount -= rxScanned;
+      rxScanned = 0;
+    }
+  }
+
+  /*! parse one extended protocol record in place, ie
+  *
+  * "get_freq:;Frequency: 28009360;RPRT 0"
+  * "get_ptt:;PTT: 0;RPRT 0"
+  * "get_mode:;Mode: USB;Passband: 2400;RPRT 0"
+  * "get_vfo:;VFO: VFOA;RPRT 0"
+  * "get_split_vfo:;Split: 0;TX VFO: VFOB;RPRT 0"
+  */
+  void RigSerial::parseReply(char *line, int len)
+  {
+    char *sep = static_cast<char *>(memchr(line, ';', len));
+    if (!sep) return;
+    *sep = '\0';
+    int cmd = -1;
+    for (int i = 0; i < kRigctldNCmds; i++) {
+      if (strcmp(line, rigctldCmds[i].reply) == 0) {
+        cmd = i;
+        break;
+      }
+    }
+    if (cmd < 0) return;
+    takePending(cmd);
+
+    char *field = sep + 1;
+    char *next = strchr(field, ';');
+    if (next) {
+      *next = '\0';
+      char *rprt = strstr(next + 1, "RPRT ");
+      if (rprt && atoi(rprt + 5) != 0) return; // rigctld error
+    }
+    char *value = strchr(field, ':'); // "RPRT -n" alone has no value
+    if (!value || strncmp(field, "RPRT", 4) == 0) return;
+    value++;
+    while (*value == ' ') value++;
+
+    char *endp;
+    switch (cmd) {
+      case kGetFreq: {
+        double f = strtod(value, &endp);
+        if (endp != value) setRigFreq(f);
+        break;
+      }
+      case kGetPtt: {
+        long p = strtol(value, &endp, 10);
+        if (endp != value) setRigPtt(p != 0);
+        break;
+      }
+      case kGetMode: {
+        quint64 m = rig_parse_mode(value);
+        if (m != state.mode) {
+          state.mode = m;
+          publishState();
+        }
+        break;
+      }
+      case kGetVfo: {
+        int v = rig_parse_vfo(value);
+        if (v != state.vfo) {
+          state.vfo = v;
+          publishState();
+        }
+        break;
+      }
+      case kGetSplitVfo: {
+        long sp = strtol(value, &endp, 10);
+        if (endp != value && (sp != 0) != state.split) {
+          state.split = (sp != 0);
+          publishState();
+        }
+        break;
       }
     }
-    lock.unlock();
   }
 
   /*! Slot called on error of tcpsocket (rigctld) */
   void RigSerial::tcpError(QAbstractSocket::SocketError e)
   {
     Q_UNUSED(e)
-    radioOK=false;
+    setRadioOK(false);
     emit(radioError("ERROR: Rigctld radio "+QString::number(nrig+1)+" "+ socket->errorString().toLatin1()));
   }
@@ -44,6 +44,34 @@ public:
 class QSettings;
 class QTcpSocket;
 
+/*!
+   Consistent view of one radio, see RigSerial::rigState
+ */
+struct RigState
+{
+    double freq = 0;       // Hz
+    bool   ptt = false;
+    bool   ok = false;     // radio open
+    quint64 mode = 0;      // rmode_t, rigctld get_mode only
+    int    vfo = 0;        // vfo_t, rigctld get_vfo only
+    bool   split = false;  // rigctld get_split_vfo only
+    qint64 timestamp = 0;  // ms since epoch of last change
+};
+
+/*!
+   rigctld request pipeline statistics, see RigSerial::rigctldStats
+ */
+struct RigctldStats
+{
+    int     lastRtt = 0;   // ms
+    int     minRtt = 0;
+    int     maxRtt = 0;
+    double  avgRtt = 0;    // smoothed
+    quint32 replies = 0;
+    quint32 timeouts = 0;  // commands dropped without reply
+    quint32 skipped = 0;   // polls not sent, pipeline full
+};
+
 /*!
    Radio serial communications for both radios using Hamlib library.
 
@@ -56,15 +84,17 @@ Q_OBJECT
 public:
     RigSerial(int);
     ~RigSerial();
-    double getRigFreq();
-    bool getRigPtt();
+    RigState rigState() const;
+    RigctldStats rigctldStats() const;
+    double getRigFreq() const;
+    bool getRigPtt() const;
     QString hamlibModelName(int i, int indx) const;
     int hamlibNMfg() const;
     int hamlibNModels(int i) const;
     int hamlibModelIndex(int, int) const;
     void hamlibModelLookup(int, int&, int&) const;
     QString hamlibMfgName(int i) const;
-    bool radioOpen();
+    bool radioOpen() const;
     void sendRaw(QByteArray cmd);
 
     static QList<hamlibmfg>        mfg;
@@ -72,6 +102,9 @@ public:
 
 signals:
     void radioError(const QString &);
+    void frequencyChanged(double);
+    void pttChanged(bool);
+    void connectionChanged(bool);
 
 public slots:
     void run();
@@ -84,22 +117,97 @@ protected:
 private slots:
     void rxSocket();
     void tcpError(QAbstractSocket::SocketError e);
+    void trnCheck();
 
 private:
     static int list_caps(const struct rig_caps *caps, void *data);
+    static int trnFreqCallback(RIG *, vfo_t, freq_t, rig_ptr_t);
+    static int trnPttCallback(RIG *, vfo_t, ptt_t, rig_ptr_t);
 
     void openRig();
     void openSocket();
     void timeoutTimer();
-
-    bool             radioOK;
-    double           rigFreq;
-    bool             rigPtt;
+    void setRigFreq(double);
+    void setRigPtt(bool);
+    void setRadioOK(bool);
+    void publishState();
+    void adaptPollRate();
+    void trnWake(int);
+    void resetRxSocket();
+    void parseRxSocket();
+    void parseReply(char *, int);
+    void addPending(int, qint64, bool);
+    void removePending(int);
+    bool takePending(int);
+    void expirePending();
+
+    // rigctld commands that can be polled
+    enum RigctldCmd { kGetFreq, kGetPtt, kGetMode, kGetVfo, kGetSplitVfo, kRigctldNCmds };
+    struct RigctldCmdInfo {
+        const char *reply;    // reply record header
+        const char *request;  // extended protocol request
+    };
+    static const RigctldCmdInfo rigctldCmds[kRigctldNCmds];
+
+    RigState         state;  // owned by the radio thread
+    bool             activity;  // state changed since last poll rate update
+    bool             transceive; // radio pushes changes, poll only as keep-alive
+    int              pollFloor;
+    int              pollCeiling;
+    int              pollInterval;
     int              model;
     int              nrig;
-    QReadWriteLock   lock;
+
+    // seqlock published copy of state, sequence is odd while writing
+    std::atomic<quint32> stateSeq{0};
+    std::atomic<double>  sharedFreq{0};
+    std::atomic<bool>    sharedPtt{false};
+    std::atomic<bool>    sharedOk{false};
+    std::atomic<quint64> sharedMode{0};
+    std::atomic<int>     sharedVfo{0};
+    std::atomic<bool>    sharedSplit{false};
+    std::atomic<qint64>  sharedTimestamp{0};
+
+    // rigctld receive ring, rxCount bytes from rxStart, first rxScanned
+    // of them already known to hold no newline
+    char             rxRing[kRigctldRxSize];
+    int              rxStart;
+    int              rxCount;
+    int              rxScanned;
+    char             rxLine[kRigctldLineSize];
+
+    // commands written to rigctld in order, not yet answered. at most
+    // pollDepth batches are in flight, last marks the end of a batch
+    struct Pending {
+        int    cmd;
+        qint64 sent;  // clock ms
+        bool   last;
+    };
+    Pending          pending[kRigctldMaxPending];
+    int              pendingHead;
+    int              pendingCount;
+    int              inFlight;
+    QByteArray       pollBatch;  // all poll requests, one write
+    int              pollCmds[kRigctldNCmds];
+    int              nPollCmds;
+    int              pollDepth;
+    int              pollTimeout;
+    QElapsedTimer    clock;
+    RigctldStats     stats;
+    mutable QMutex   statsMutex;
     RIG              *rig;
     QSettings        *settings;
     QTcpSocket       *socket;
     QTimer           timer{this};
+
+    // values from the transceive callbacks, written with lock free atomics
+    // only (async-signal-safe), flags say which are new. the callback that
+    // sets the first flag writes a byte to trnPipe, trnNotifier wakes the
+    // radio thread for it
+    enum { kTrnFreq = 1, kTrnPtt = 2 };
+    int              trnPipe[2];
+    QSocketNotifier  *trnNotifier;
+    std::atomic<qint64> trnFreqValue{0};  // Hz
+    std::atomic<bool>   trnPttValue{false};
+    std::atomic<int>    trnFlags{0};
 };
@@ -10,11 +10,23 @@ SOURCES += main.cpp \
         mainwindow.cpp \
         serial.cpp \
         delegates.cpp \
+        topology.cpp \
+        websocketio.cpp \
+        logger.cpp \
+        logmodel.cpp \
+        journal.cpp \
+        rs485io.cpp \
 
 HEADERS += mainwindow.hpp \
         serial.hpp \
         defines.hpp \
         delegates.hpp \
+        topology.hpp \
+        websocketio.hpp \
+        logger.hpp \
+        logmodel.hpp \
+        journal.hpp \
+        rs485io.hpp \
         cron.hpp \
 
 FORMS += mainwindow.ui \
@@ -0,0 +1,17 @@
+QT = core
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = journalreader
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+        ../../journal.cpp \
+
+HEADERS += ../../journal.hpp \
+
+unix|win32-g++ {
+    QMAKE_CXXFLAGS += -O2 -Wall
+}
@@ -0,0 +1,148 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+
+    journalreader: export or replay a range of the softrx switching journal
+ */
+
+#include "journal.hpp"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QThread>
+#include <climits>
+
+/*! time as ISO date/time (local) or ms since epoch, -1 if neither
+*/
+static qint64 parseTime(const QString &text)
+{
+  bool ok;
+  qint64 ms = text.toLongLong(&ok);
+  if (ok) return ms;
+  QDateTime t = QDateTime::fromString(text, Qt::ISODate);
+  return t.isValid() ? t.toMSecsSinceEpoch() : -1;
+}
+
+static int parseCause(const QString &text)
+{
+  for (int i=0; i<kNCauses; ++i) {
+    if (text == QLatin1String(kCauseNames[i])) return i;
+  }
+  return -1;
+}
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("softrx"); // journal is under the softrx config dir
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Export or replay the softrx antenna switching journal.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("dir", "Journal directory, default <config dir>/journal.", "[dir]");
+  QCommandLineOption fromOption("from", "First record, ISO time or ms since epoch.", "time");
+  QCommandLineOption toOption("to", "Last record, ISO time or ms since epoch.", "time");
+  QCommandLineOption firstOption("first", "First record by sequence number.", "seq");
+  QCommandLineOption lastOption("last", "Last record by sequence number.", "seq");
+  QCommandLineOption radioOption("radio", "Only radio n (1-8).", "n");
+  QCommandLineOption causeOption("cause", "Only cause (other, cat, cron, client, tracking, scan).", "cause");
+  QCommandLineOption csvOption("csv", "CSV output.");
+  QCommandLineOption replayOption("replay", "Print records paced as they happened, speed times faster.", "speed");
+  QCommandLineOption countOption("count", "Only print the number of matching records per radio and cause.");
+  parser.addOptions({ fromOption, toOption, firstOption, lastOption, radioOption, causeOption, csvOption, replayOption, countOption });
+  parser.process(app);
+
+  QString dir = parser.positionalArguments().value(0,
+                  QDir(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)).absoluteFilePath("journal"));
+  qint64 from = parser.isSet(fromOption) ? parseTime(parser.value(fromOption)) : 0;
+  qint64 to = parser.isSet(toOption) ? parseTime(parser.value(toOption)) : LLONG_MAX;
+  quint64 first = parser.isSet(firstOption) ? parser.value(firstOption).toULongLong() : 0;
+  quint64 last = parser.isSet(lastOption) ? parser.value(lastOption).toULongLong() : ULLONG_MAX;
+  int radio = parser.isSet(radioOption) ? parser.value(radioOption).toInt() - 1 : -1;
+  int cause = parser.isSet(causeOption) ? parseCause(parser.value(causeOption)) : -1;
+  double speed = parser.isSet(replayOption) ? parser.value(replayOption).toDouble() : 0.0;
+
+  QTextStream err(stderr);
+  QTextStream out(stdout);
+  if (from < 0 || to < 0) {
+    err << "bad time, use ISO (2021-06-12T14:00:00) or ms since epoch\n";
+    return 1;
+  }
+  if (parser.isSet(causeOption) && cause < 0) {
+    err << "unknown cause " << parser.value(causeOption) << "\n";
+    return 1;
+  }
+  if (parser.isSet(replayOption) && speed <= 0.0) {
+    err << "replay speed must be > 0\n";
+    return 1;
+  }
+
+  QStringList segments = Journal::segments(dir);
+  if (segments.isEmpty()) {
+    err << "no journal in " << dir << "\n";
+    return 1;
+  }
+
+  if (parser.isSet(csvOption)) {
+    out << "seq,time,mono_ns,radio,cause,band,group,antenna,port,bearing\n";
+  }
+  quint64 counts[256][kNCauses] = {};
+  qint64 lastMono = -1;
+  for (const QString &name : segments) {
+    JournalSegment segment;
+    if (!segment.open(QDir(dir).absoluteFilePath(name))) {
+      err << "skipping " << name << ", not a journal segment\n";
+      continue;
+    }
+    if (!segment.count()) continue;
+    // only seq is ordered, wall time can step back (NTP, clock set by
+    // hand), so segments are skipped by seq and times filtered one by one
+    quint64 segFirst = segment.firstSeq();
+    quint64 segLast = segFirst + segment.count() - 1;
+    if (segLast < first || segFirst > last) continue;
+    const JournalRecord *r = segment.begin() + (first > segFirst ? first - segFirst : 0);
+    const JournalRecord *end = segment.begin() + (last < segLast ? last - segFirst + 1 : segment.count());
+    for (; r != end; ++r) {
+      quint64 seq = segment.seq(r);
+      if (r->wall < from || r->wall > to) continue;
+      if (radio >= 0 && r->radio != radio) continue;
+      if (cause >= 0 && r->cause != cause) continue;
+      if (parser.isSet(countOption)) {
+        if (r->cause < kNCauses) counts[r->radio][r->cause]++;
+        continue;
+      }
+      if (speed > 0.0) {
+        if (lastMono >= 0 && r->mono > lastMono) {
+          out.flush();
+          QThread::usleep(quint64((r->mono - lastMono) / 1000 / speed));
+        }
+        lastMono = r->mono;
+      }
+      QString time = QDateTime::fromMSecsSinceEpoch(r->wall).toString("yyyy-MM-dd hh:mm:ss.zzz");
+      const char *causeName = (r->cause < kNCauses) ? kCauseNames[r->cause] : "?";
+      if (parser.isSet(csvOption)) {
+        out << seq << "," << time << "," << r->mono << "," << r->radio + 1 << ","
+            << causeName << "," << r->band << "," << r->group << "," << r->antenna << ","
+            << r->port << "," << r->bearing << "\n";
+      } else {
+        out << "[" << time << "] #" << seq << " radio " << r->radio + 1
+            << " " << causeName << ": band " << r->band << " group " << r->group
+            << " antenna " << r->antenna << " port " << r->port;
+        if (r->bearing >= 0) out << " bearing " << r->bearing;
+        out << "\n";
+      }
+    }
+  }
+
+  if (parser.isSet(countOption)) {
+    for (int i=0; i<256; ++i) {
+      for (int c=0; c<kNCauses; ++c) {
+        if (counts[i][c]) out << "radio " << i + 1 << " " << kCauseNames[c] << " " << counts[i][c] << "\n";
+      }
+    }
+  }
+  return 0;
+}
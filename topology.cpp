@@ -0,0 +1,349 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#include "topology.hpp"
+
+/*! rebuild the whole snapshot from the database
+
+  called at startup and after any change to the bands, groups,
+  antennas or map tables has been committed
+*/
+void Topology::load(QSqlDatabase &db)
+{
+  Topology t;
+  QSqlQuery query(db);
+
+  query.exec("SELECT * from bands ORDER BY start_freq");
+  while (query.next()) {
+    Band b;
+    b.id = query.value("id").toInt();
+    if (b.id <= 0) continue;
+    b.name = query.value("name").toString();
+    b.start_freq = query.value("start_freq").toInt();
+    b.stop_freq = query.value("stop_freq").toInt();
+    b.cat_id = query.value("cat_id").toInt();
+    b.gain = query.value("gain").toInt();
+    b.bpf = query.value("bpf").toInt();
+    b.hpf = query.value("hpf").toInt();
+    b.aux = query.value("aux").toInt();
+    if (b.id >= t.bands.size()) t.bands.resize(b.id + 1);
+    t.bands[b.id] = b;
+    t.bandOrder << b.id;
+  }
+
+  query.exec("SELECT * from groups");
+  while (query.next()) {
+    Group g;
+    g.id = query.value("id").toInt();
+    if (g.id <= 0) continue;
+    g.name = query.value("name").toString();
+    g.label = query.value("label").toString();
+    g.display_mode = query.value("display_mode").toInt();
+    g.gain = query.value("gain").toInt();
+    g.priority = query.value("priority").toInt();
+    g.enabled = query.value("enabled").toBool();
+    g.radios1_4 = query.value("radios1_4").toBool();
+    g.radios5_8 = query.value("radios5_8").toBool();
+    if (g.id >= t.groups.size()) t.groups.resize(g.id + 1);
+    t.groups[g.id] = g;
+  }
+
+  query.exec("SELECT * from antennas");
+  while (query.next()) {
+    Antenna a;
+    a.id = query.value("id").toInt();
+    if (a.id <= 0) continue;
+    a.name = query.value("name").toString();
+    a.label = query.value("label").toString();
+    a.switch_port = query.value("switch_port").toInt();
+    a.vant = query.value("vant").toInt();
+    a.start_deg = query.value("start_deg").toInt();
+    a.stop_deg = query.value("stop_deg").toInt();
+    a.gain = query.value("gain").toInt();
+    a.priority = query.value("priority").toInt();
+    a.radios1_4 = query.value("radios1_4").toBool();
+    a.radios5_8 = query.value("radios5_8").toBool();
+    a.scan = query.value("scan").toBool();
+    a.enabled = query.value("enabled").toBool();
+    if (a.id >= t.antennas.size()) t.antennas.resize(a.id + 1);
+    t.antennas[a.id] = a;
+  }
+
+  t.bandGroupMap.resize(t.bands.size());
+  query.exec("SELECT band_id, group_id from band_group_map ORDER BY id");
+  while (query.next()) {
+    int bandId = query.value("band_id").toInt();
+    int groupId = query.value("group_id").toInt();
+    if (!t.band(bandId) || !t.group(groupId)) continue;
+    if (!t.bandGroupMap[bandId].contains(groupId)) {
+      t.bandGroupMap[bandId] << groupId;
+    }
+  }
+
+  t.groupAntennaMap.resize(t.groups.size());
+  query.exec("SELECT group_id, antenna_id from group_antenna_map ORDER BY id");
+  while (query.next()) {
+    int groupId = query.value("group_id").toInt();
+    int antennaId = query.value("antenna_id").toInt();
+    if (!t.group(groupId) || !t.antenna(antennaId)) continue;
+    if (!t.groupAntennaMap[groupId].contains(antennaId)) {
+      t.groupAntennaMap[groupId] << antennaId;
+    }
+  }
+
+  // precomputed selection lists, same filtering and ordering as the
+  // per-event SQL they replace
+  for (int k=0; k<2; ++k) {
+    t.groupList[k].resize(t.bands.size());
+    for (int b=0; b<t.bandGroupMap.size(); ++b) {
+      for (int g : qAsConst(t.bandGroupMap.at(b))) {
+        const Group &grp = t.groups.at(g);
+        if (grp.enabled && (k == 0 ? grp.radios1_4 : grp.radios5_8)) {
+          t.groupList[k][b] << g;
+        }
+      }
+      std::sort(t.groupList[k][b].begin(), t.groupList[k][b].end(),
+                [&t](int x, int y) {
+                  if (t.groups.at(x).priority != t.groups.at(y).priority) {
+                    return t.groups.at(x).priority > t.groups.at(y).priority;
+                  }
+                  return x > y;
+                });
+    }
+
+    t.antennaDegList[k].resize(t.groups.size());
+    t.antennaPrioList[k].resize(t.groups.size());
+    for (int g=0; g<t.groupAntennaMap.size(); ++g) {
+      QVector<int> list;
+      for (int a : qAsConst(t.groupAntennaMap.at(g))) {
+        const Antenna &ant = t.antennas.at(a);
+        if (ant.enabled && (k == 0 ? ant.radios1_4 : ant.radios5_8)) {
+          list << a;
+        }
+      }
+      std::sort(list.begin(), list.end());
+      t.antennaDegList[k][g] = list;
+      std::stable_sort(t.antennaDegList[k][g].begin(), t.antennaDegList[k][g].end(),
+                       [&t](int x, int y) {
+                         return t.antennas.at(x).start_deg < t.antennas.at(y).start_deg;
+                       });
+      t.antennaPrioList[k][g] = list;
+      std::stable_sort(t.antennaPrioList[k][g].begin(), t.antennaPrioList[k][g].end(),
+                       [&t](int x, int y) {
+                         return t.antennas.at(x).priority > t.antennas.at(y).priority;
+                       });
+    }
+
+    t.bearingDegTable[k].resize(t.groups.size());
+    t.bearingPrioTable[k].resize(t.groups.size());
+    for (int g=0; g<t.groups.size(); ++g) {
+      t.bearingDegTable[k][g] = t.buildBearingTable(t.antennaDegList[k].at(g));
+      t.bearingPrioTable[k][g] = t.buildBearingTable(t.antennaPrioList[k].at(g));
+    }
+  }
+
+  t.buildBandRanges();
+  t.generation = generation + 1; // invalidates callers' band hints
+
+  *this = std::move(t);
+}
+
+/*! split the bands table into disjoint frequency ranges
+
+  where bands overlap, the range belongs to the band with the lowest
+  start frequency, same as the first match of a linear scan ordered
+  by start_freq
+*/
+void Topology::buildBandRanges()
+{
+  QVector<int> edges;
+  for (int id : qAsConst(bandOrder)) {
+    const Band &b = bands.at(id);
+    if (b.stop_freq < b.start_freq) continue;
+    edges << b.start_freq << b.stop_freq + 1;
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  bandRanges.clear();
+  for (int i = 0; i + 1 < edges.size(); ++i) {
+    int owner = 0;
+    for (int id : qAsConst(bandOrder)) {
+      const Band &b = bands.at(id);
+      if (edges.at(i) >= b.start_freq && edges.at(i) <= b.stop_freq) {
+        owner = id;
+        break;
+      }
+    }
+    if (!owner) continue;
+    if (!bandRanges.isEmpty() && bandRanges.last().band == owner &&
+        bandRanges.last().stop_freq + 1 == edges.at(i)) {
+      bandRanges.last().stop_freq = edges.at(i + 1) - 1; // merge
+    } else {
+      bandRanges << BandRange{ edges.at(i), edges.at(i + 1) - 1, owner };
+    }
+  }
+}
+
+/*! true if antenna beam covers bearing, handles stop_deg < start_deg
+  wrapping through north
+*/
+bool Topology::coversBearing(const Antenna &ant, int bearing)
+{
+  if (bearing >= ant.start_deg && bearing <= ant.stop_deg) {
+    return true;
+  } else if (ant.stop_deg < ant.start_deg) {
+    if (bearing >= ant.start_deg && bearing <= ant.stop_deg + 360) {
+      return true;
+    } else if (bearing >= ant.start_deg - 360 && bearing <= ant.stop_deg) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*! 360 entry table of the antennas covering each degree, keeps the
+  order of the given list
+*/
+Topology::BearingTable Topology::buildBearingTable(const QVector<int> &list) const
+{
+  BearingTable table;
+  table.offset.resize(361);
+  for (int deg=0; deg<360; ++deg) {
+    table.offset[deg] = table.ids.size();
+    for (int id : list) {
+      if (coversBearing(antennas.at(id), deg)) {
+        table.ids << id;
+      }
+    }
+  }
+  table.offset[360] = table.ids.size();
+  return table;
+}
+
+/*! band id covering frequency (kHz), 0 if none
+
+  if a hint is given and the frequency is still inside the range of the
+  previous result no search is done, otherwise the hint is updated with
+  the range (or gap between bands) containing the frequency
+*/
+int Topology::bandAtFreq(int kHz, BandHint *hint) const
+{
+  if (hint && hint->generation == generation &&
+      kHz >= hint->start_freq && kHz <= hint->stop_freq) {
+    return hint->band;
+  }
+
+  // first range starting above kHz, candidate is the one before it
+  auto it = std::upper_bound(bandRanges.begin(), bandRanges.end(), kHz,
+                             [](int f, const BandRange &r) { return f < r.start_freq; });
+  int band = 0;
+  int start = INT_MIN;
+  int stop = (it == bandRanges.end()) ? INT_MAX : it->start_freq - 1;
+  if (it != bandRanges.begin()) {
+    const BandRange &r = *(it - 1);
+    if (kHz <= r.stop_freq) {
+      band = r.band;
+      start = r.start_freq;
+      stop = r.stop_freq;
+    } else {
+      start = r.stop_freq + 1;
+    }
+  }
+
+  if (hint) {
+    hint->start_freq = start;
+    hint->stop_freq = stop;
+    hint->band = band;
+    hint->generation = generation;
+  }
+  return band;
+}
+
+const Topology::Band *Topology::band(int id) const
+{
+  if (id > 0 && id < bands.size() && bands.at(id).id == id) {
+    return &bands.at(id);
+  }
+  return nullptr;
+}
+
+const Topology::Band *Topology::bandByName(const QString &name) const
+{
+  for (int id : bandOrder) {
+    if (bands.at(id).name == name) {
+      return &bands.at(id);
+    }
+  }
+  return nullptr;
+}
+
+const Topology::Group *Topology::group(int id) const
+{
+  if (id > 0 && id < groups.size() && groups.at(id).id == id) {
+    return &groups.at(id);
+  }
+  return nullptr;
+}
+
+const Topology::Antenna *Topology::antenna(int id) const
+{
+  if (id > 0 && id < antennas.size() && antennas.at(id).id == id) {
+    return &antennas.at(id);
+  }
+  return nullptr;
+}
+
+int Topology::displayMode(int id) const
+{
+  const Group *g = group(id);
+  return g ? g->display_mode : kDispNone;
+}
+
+int Topology::switchPort(int id) const
+{
+  const Antenna *a = antenna(id);
+  return a ? a->switch_port : -1;
+}
+
+const QVector<int> &Topology::lookup(const QVector<QVector<int>> &list, int id)
+{
+  static const QVector<int> none;
+  if (id > 0 && id < list.size()) {
+    return list.at(id);
+  }
+  return none;
+}
+
+const QVector<int> &Topology::groupsForBand(int band, int nrig) const
+{
+  return lookup(groupList[bank(nrig)], band);
+}
+
+const QVector<int> &Topology::antennasByBearing(int group, int nrig) const
+{
+  return lookup(antennaDegList[bank(nrig)], group);
+}
+
+const QVector<int> &Topology::antennasByPriority(int group, int nrig) const
+{
+  return lookup(antennaPrioList[bank(nrig)], group);
+}
+
+Topology::Candidates Topology::bearingCandidates(int group, int nrig, int bearing, int display_mode) const
+{
+  Candidates c;
+  const QVector<BearingTable> &tables = (display_mode == kDispCompass) ?
+                                         bearingDegTable[bank(nrig)] :
+                                         bearingPrioTable[bank(nrig)];
+  if (group <= 0 || group >= tables.size() || bearing < 0) {
+    return c;
+  }
+  bearing %= 360;
+  const BearingTable &table = tables.at(group);
+  c.first = table.ids.constData() + table.offset.at(bearing);
+  c.last = table.ids.constData() + table.offset.at(bearing + 1);
+  return c;
+}
@@ -0,0 +1,139 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#pragma once
+
+#include "defines.hpp"
+
+/*!
+   In-memory snapshot of the bands, groups, antennas and map tables.
+
+   Records are stored in flat vectors indexed by database id. The snapshot
+   is rebuilt from SQLite only when the database is changed, all runtime
+   selection lookups read from here instead of the database.
+ */
+class Topology
+{
+public:
+  struct Band {
+    int id = 0;
+    QString name;
+    int start_freq = 0;
+    int stop_freq = 0;
+    int cat_id = 0;
+    int gain = 0;
+    int bpf = 0;
+    int hpf = 0;
+    int aux = 0;
+  };
+
+  struct Group {
+    int id = 0;
+    QString name;
+    QString label;
+    int display_mode = kDispNone;
+    int gain = 0;
+    int priority = 0;
+    bool enabled = false;
+    bool radios1_4 = false;
+    bool radios5_8 = false;
+  };
+
+  struct Antenna {
+    int id = 0;
+    QString name;
+    QString label;
+    int switch_port = -1;
+    int vant = 0;
+    int start_deg = 0;
+    int stop_deg = 0;
+    int gain = 0;
+    int priority = 0;
+    bool radios1_4 = false;
+    bool radios5_8 = false;
+    bool scan = false;
+    bool enabled = false;
+  };
+
+  // last frequency lookup result, kept by the caller per radio
+  struct BandHint {
+    int start_freq = 0;
+    int stop_freq = -1;
+    int band = 0;
+    quint32 generation = 0;
+  };
+
+  // antenna ids covering one bearing, iterable with range-for
+  struct Candidates {
+    const int *first = nullptr;
+    const int *last = nullptr;
+    const int *begin() const { return first; }
+    const int *end() const { return last; }
+    bool isEmpty() const { return first == last; }
+  };
+
+  void load(QSqlDatabase &);
+
+  const Band *band(int) const;
+  const Band *bandByName(const QString &) const;
+  const Group *group(int) const;
+  const Antenna *antenna(int) const;
+
+  int bandAtFreq(int, BandHint * = nullptr) const;
+
+  int displayMode(int) const;
+  // changes on every load
+  quint32 loadGeneration() const { return generation; }
+  int switchPort(int) const;
+
+  // band ids ordered by start frequency
+  const QVector<int> &bandsByFreq() const { return bandOrder; }
+  // enabled groups of a band usable by radio, priority desc, id desc
+  const QVector<int> &groupsForBand(int, int) const;
+  // enabled antennas of a group usable by radio, start_deg asc
+  const QVector<int> &antennasByBearing(int, int) const;
+  // enabled antennas of a group usable by radio, priority desc, id asc
+  const QVector<int> &antennasByPriority(int, int) const;
+  // antennas of a group usable by radio covering bearing, ordered as
+  // antennasByBearing (compass) or antennasByPriority (other modes)
+  Candidates bearingCandidates(int, int, int, int = kDispCompass) const;
+
+private:
+  // disjoint frequency range (kHz) mapped to the band that covers it
+  struct BandRange {
+    int start_freq;
+    int stop_freq;
+    int band;
+  };
+
+  // antenna ids per degree, ids[offset[d]] .. ids[offset[d+1]-1]
+  struct BearingTable {
+    QVector<int> offset;
+    QVector<int> ids;
+  };
+
+  static int bank(int nrig) { return (nrig < 4) ? 0 : 1; }
+  static bool coversBearing(const Antenna &, int);
+  void buildBandRanges();
+  BearingTable buildBearingTable(const QVector<int> &) const;
+  static const QVector<int> &lookup(const QVector<QVector<int>> &, int);
+
+  QVector<Band> bands;       // indexed by id, id 0 unused
+  QVector<Group> groups;
+  QVector<Antenna> antennas;
+  QVector<int> bandOrder;
+  QVector<BandRange> bandRanges; // sorted by start_freq, non overlapping
+  quint32 generation = 0;
+
+  QVector<QVector<int>> bandGroupMap;    // band id -> group ids
+  QVector<QVector<int>> groupAntennaMap; // group id -> antenna ids
+
+  // [radios1_4, radios5_8]
+  QVector<QVector<int>> groupList[2];       // by band id
+  QVector<QVector<int>> antennaDegList[2];  // by group id
+  QVector<QVector<int>> antennaPrioList[2]; // by group id
+  QVector<BearingTable> bearingDegTable[2];  // by group id
+  QVector<BearingTable> bearingPrioTable[2]; // by group id
+};
@@ -0,0 +1,198 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#include "websocketio.hpp"
+
+WebSocketIO::WebSocketIO(int highWater, int maxQueue, int stallTime)
+{
+  server = nullptr;
+  this->highWater = highWater;
+  this->maxQueue = maxQueue;
+  this->stallTime = stallTime;
+  nDropped = 0;
+  reportedDropped = 0;
+  nSlow = 0;
+  nextId = 1;
+  stallTimer = new QTimer(this); // moved to the I/O thread along with this
+  stallTimer->setInterval(1000);
+  connect(stallTimer, &QTimer::timeout, this, &WebSocketIO::checkStalled);
+}
+
+WebSocketIO::~WebSocketIO()
+{
+  for (QWebSocket *ws : ids.keys()) {
+    disconnect(ws, nullptr, this, nullptr);
+    ws->abort();
+    delete ws;
+  }
+  ids.clear();
+  clients.clear();
+  delete server;
+}
+
+/*! (re)start listening, existing clients stay connected on the
+  original port
+*/
+void WebSocketIO::listen(int port)
+{
+  bool restart = (server != nullptr);
+  if (!server) {
+    server = new QWebSocketServer(QStringLiteral("softrx"),
+                                  QWebSocketServer::NonSecureMode,
+                                  this);
+    connect(server, &QWebSocketServer::newConnection, this, &WebSocketIO::onNewConnection);
+    stallTimer->start();
+  }
+  server->close();
+  emit(listening(server->listen(QHostAddress::Any, port), port, restart));
+}
+
+/*! write a frame to a client, ignored if it has gone meanwhile
+
+  keys are the object/method of the updates in the frame. if replaces is
+  set, queued frames whose updates are all repeated in this one are
+  dropped. frames holding deltas must not replace anything, the client
+  needs the version they are based on
+*/
+void WebSocketIO::send(quint64 id, const QByteArray &data, const QStringList &keys, bool replaces)
+{
+  auto it = clients.find(id);
+  if (it == clients.end()) return;
+  Client &client = it.value();
+
+  if (client.queue.isEmpty() && client.outstanding < highWater) {
+    write(client, data);
+    return;
+  }
+
+  Frame frame{ data, keys };
+  std::sort(frame.keys.begin(), frame.keys.end());
+  if (replaces) {
+    for (auto q = client.queue.begin(); q != client.queue.end(); ) {
+      if (covers(frame.keys, q->keys)) {
+        client.queued -= q->data.size();
+        client.dropped++;
+        nDropped.fetch_add(1, std::memory_order_relaxed);
+        q = client.queue.erase(q);
+      } else {
+        ++q;
+      }
+    }
+  }
+  client.queue << frame;
+  client.queued += data.size();
+  if (client.queued > maxQueue) {
+    disconnectSlow(id, client);
+  }
+}
+
+/*! true if every key of old is in keys, both sorted
+*/
+bool WebSocketIO::covers(const QStringList &keys, const QStringList &old)
+{
+  return std::includes(keys.constBegin(), keys.constEnd(), old.constBegin(), old.constEnd());
+}
+
+void WebSocketIO::write(Client &client, const QByteArray &data)
+{
+  client.outstanding += client.ws->sendBinaryMessage(data);
+  if (client.outstanding >= highWater && !client.highSince) {
+    client.highSince = QDateTime::currentMSecsSinceEpoch();
+  }
+}
+
+/*! send queued frames while below high water
+*/
+void WebSocketIO::drain(Client &client)
+{
+  while (!client.queue.isEmpty() && client.outstanding < highWater) {
+    Frame frame = client.queue.takeFirst();
+    client.queued -= frame.data.size();
+    write(client, frame.data);
+  }
+}
+
+/*! abort the socket, cleanup happens in onDisconnected
+*/
+void WebSocketIO::disconnectSlow(quint64 id, Client &client)
+{
+  nSlow.fetch_add(1, std::memory_order_relaxed);
+  emit(slowClient(id, client.dropped, nSlow.load(std::memory_order_relaxed)));
+  client.queue.clear();
+  client.queued = 0;
+  client.ws->abort();
+}
+
+void WebSocketIO::onNewConnection()
+{
+  while (server->hasPendingConnections()) {
+    QWebSocket *ws = server->nextPendingConnection();
+    ws->setParent(this);
+    connect(ws, &QWebSocket::binaryMessageReceived, this, &WebSocketIO::onMessage);
+    connect(ws, &QWebSocket::bytesWritten, this, &WebSocketIO::onBytesWritten);
+    connect(ws, &QWebSocket::disconnected, this, &WebSocketIO::onDisconnected);
+    quint64 id = nextId++;
+    Client client;
+    client.ws = ws;
+    clients.insert(id, client);
+    ids.insert(ws, id);
+    emit(clientConnected(id, QString("%1:%2")
+                               .arg(ws->peerAddress().toString())
+                               .arg(ws->peerPort())));
+  }
+}
+
+void WebSocketIO::onMessage(const QByteArray &message)
+{
+  quint64 id = ids.value(qobject_cast<QWebSocket *>(sender()));
+  if (id) emit(messageReceived(id, message));
+}
+
+/*! bytes written include frame headers, which are not counted when
+  sending, so outstanding is kept from going negative
+*/
+void WebSocketIO::onBytesWritten(qint64 bytes)
+{
+  auto it = clients.find(ids.value(qobject_cast<QWebSocket *>(sender())));
+  if (it == clients.end()) return;
+  Client &client = it.value();
+  client.outstanding = qMax(client.outstanding - bytes, qint64(0));
+  if (client.outstanding < highWater) client.highSince = 0;
+  drain(client);
+}
+
+void WebSocketIO::onDisconnected()
+{
+  QWebSocket *ws = qobject_cast<QWebSocket *>(sender());
+  quint64 id = ids.take(ws);
+  if (id && clients.remove(id)) {
+    emit(clientDisconnected(id));
+    ws->deleteLater();
+  }
+}
+
+/*! disconnect clients that have not taken any data for stallTime, and
+  report frames superseded since the last check
+*/
+void WebSocketIO::checkStalled()
+{
+  quint64 dropped = nDropped.load(std::memory_order_relaxed);
+  if (dropped != reportedDropped) {
+    emit(framesDropped(dropped - reportedDropped, dropped));
+    reportedDropped = dropped;
+  }
+
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  QList<quint64> stalled;
+  for (auto it = clients.begin(); it != clients.end(); ++it) {
+    if (it->highSince && now - it->highSince > stallTime) {
+      stalled << it.key();
+    }
+  }
+  for (quint64 id : qAsConst(stalled)) {
+    auto it = clients.find(id);
+    if (it != clients.end()) disconnectSlow(id, it.value());
+  }
+}
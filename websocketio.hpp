@@ -0,0 +1,86 @@
+/*!
+    Software RX Switching E. Tichansky NO3M 2021
+    v0.1
+ */
+
+#pragma once
+
+#include "defines.hpp"
+
+/*!
+   Websocket server and client sockets, runs in its own QThread.
+
+   MainWindow talks to it only through queued signals/slots. Each
+   connection gets an id, never reused, that MainWindow addresses the
+   client with; a frame queued for a client that has gone meanwhile is
+   dropped rather than reaching a newer connection. Sockets are never
+   touched outside this thread.
+
+   Frames are written to a client only while less than highWater bytes
+   are outstanding on its socket, the rest wait in a per-client queue. A
+   queued frame is dropped when a newer one replaces all the updates it
+   carries (latest state wins). A client whose queue grows past maxQueue
+   or that stays above high water for stallTime ms is disconnected.
+   Superseded frames are reported once a second while they occur
+   (framesDropped), slow clients as they are disconnected (slowClient).
+ */
+class WebSocketIO : public QObject
+{
+Q_OBJECT
+
+public:
+    WebSocketIO(int highWater, int maxQueue, int stallTime);
+    ~WebSocketIO();
+    quint64 droppedFrames() const { return nDropped.load(std::memory_order_relaxed); }
+    quint64 slowDisconnects() const { return nSlow.load(std::memory_order_relaxed); }
+
+signals:
+    void listening(bool, int, bool);
+    void clientConnected(quint64, const QString &);
+    void clientDisconnected(quint64);
+    void messageReceived(quint64, const QByteArray &);
+    void slowClient(quint64, int, quint64);
+    void framesDropped(quint64, quint64);
+
+public slots:
+    void listen(int);
+    void send(quint64, const QByteArray &, const QStringList &, bool);
+
+private slots:
+    void onNewConnection();
+    void onMessage(const QByteArray &);
+    void onBytesWritten(qint64);
+    void onDisconnected();
+    void checkStalled();
+
+private:
+    struct Frame {
+        QByteArray data;
+        QStringList keys;  // object/method of the updates it carries, sorted
+    };
+    struct Client {
+        QWebSocket *ws = nullptr;
+        qint64 outstanding = 0;  // given to the socket, not yet written
+        qint64 queued = 0;       // bytes in queue
+        qint64 highSince = 0;    // ms since epoch it went above high water, 0 if below
+        int dropped = 0;
+        QList<Frame> queue;
+    };
+
+    void write(Client &, const QByteArray &);
+    void drain(Client &);
+    void disconnectSlow(quint64, Client &);
+    static bool covers(const QStringList &, const QStringList &);
+
+    QWebSocketServer *server;
+    QHash<quint64, Client> clients;
+    QHash<QWebSocket *, quint64> ids;  // id of a socket, for its signals
+    quint64 nextId;
+    QTimer *stallTimer;
+    qint64 highWater;
+    qint64 maxQueue;
+    qint64 stallTime;
+    std::atomic<quint64> nDropped;  // superseded frames, all clients
+    quint64 reportedDropped;
+    std::atomic<quint64> nSlow;     // clients disconnected for not reading
+};